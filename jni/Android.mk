@@ -3,23 +3,35 @@ LOCAL_PATH := $(call my-dir)
 ANJAROOTDAEMON_LOGTAG := AnJaRootDaemon
 ANJAROOTNATIVE_LOGTAG := AnJaRootNative
 ANJAROOTINSTALLER_LOGTAG := AnJaRootInstaller
+# log calls below this priority are compiled out
+ANJAROOT_MIN_LOG_LEVEL ?= ANDROID_LOG_VERBOSE
 
 
 include $(CLEAR_VARS)
 LOCAL_MODULE := anjarootd
 LOCAL_SRC_FILES := anjarootd/anjarootdaemon.cpp \
 				   anjarootd/trace.cpp \
+				   anjarootd/traceetable.cpp \
 				   anjarootd/debuggerdhandler.cpp \
 				   anjarootd/zygotehandler.cpp \
 				   anjarootd/zygotechildhandler.cpp \
+				   anjarootd/zygotegroup.cpp \
 				   anjarootd/packages.cpp \
 				   anjarootd/hook.cpp \
-				   anjarootd/arch-$(TARGET_ARCH)/hook.cpp \
+				   anjarootd/stats.cpp \
+				   anjarootd/policy.cpp \
+				   anjarootd/policysnapshot.cpp \
+				   anjarootd/prefetch.cpp \
+				   anjarootd/reactor.cpp \
+				   anjarootd/supervisor.cpp \
+				   anjarootd/flightrecorder.cpp \
 				   shared/util.cpp \
+				   shared/ringlog.cpp \
 				   shared/version.cpp
 LOCAL_LDLIBS := -llog
 LOCAL_CPP_FEATURES := exceptions
 LOCAL_CPPFLAGS := -DANJAROOT_LOGTAG="\"$(ANJAROOTDAEMON_LOGTAG)\"" \
+				  -DANJAROOT_MIN_LOG_LEVEL=$(ANJAROOT_MIN_LOG_LEVEL) \
 				  -std=c++11 -Wall
 include $(BUILD_EXECUTABLE)
 
@@ -32,10 +44,12 @@ LOCAL_SRC_FILES :=	lib/wrapper.cpp \
 					lib/arch-$(TARGET_ARCH)/local_getresuid.S \
 				   	lib/arch-$(TARGET_ARCH)/local_getresgid.S \
 					shared/util.cpp \
+					shared/ringlog.cpp \
 					shared/version.cpp
 LOCAL_LDLIBS := -llog -ldl
 LOCAL_CPP_FEATURES := exceptions
 LOCAL_CPPFLAGS := -DANJAROOT_LOGTAG="\"$(ANJAROOTNATIVE_LOGTAG)\"" \
+				  -DANJAROOT_MIN_LOG_LEVEL=$(ANJAROOT_MIN_LOG_LEVEL) \
 				  -std=c++11 -Wall
 include $(BUILD_SHARED_LIBRARY)
 
@@ -58,10 +72,12 @@ LOCAL_SRC_FILES := installer/installer.cpp \
 				   installer/config.cpp \
 				   installer/compression.cpp \
 				   shared/util.cpp \
+				   shared/ringlog.cpp \
 				   shared/version.cpp
 LOCAL_LDLIBS := -llog -ldl -lz
 LOCAL_STATIC_LIBRARIES := minizip
 LOCAL_CPP_FEATURES := exceptions
 LOCAL_CPPFLAGS := -DANJAROOT_LOGTAG="\"$(ANJAROOTINSTALLER_LOGTAG)\"" \
+				  -DANJAROOT_MIN_LOG_LEVEL=$(ANJAROOT_MIN_LOG_LEVEL) \
 				  -std=c++11 -Wall
 include $(BUILD_EXECUTABLE)
@@ -18,32 +18,47 @@
  */
 #include <system_error>
 #include <iostream>
+#include <cstdlib>
+#include <climits>
 
 #include <sys/socket.h>
 #include <sys/un.h>
 
 #include "anjarootdaemon.h"
-#include "debuggerdhandler.h"
-#include "zygotehandler.h"
-#include "zygotechildhandler.h"
+#include "flightrecorder.h"
+#include "prefetch.h"
+#include "reactor.h"
+#include "stats.h"
+#include "supervisor.h"
 #include "trace.h"
 #include "shared/util.h"
 #include "shared/version.h"
 
-bool AnJaRootDaemon::shouldRun = true;
-const char* AnJaRootDaemon::shortopts = "vh";
+const char* AnJaRootDaemon::shortopts = "vhs:t:l:f:d:F:";
 const struct option AnJaRootDaemon::longopts[] = {
     {"version",         no_argument,       0, 'v'},
     {"help",            no_argument,       0, 'h'},
+    {"max-stops",       required_argument, 0, 's'},
+    {"max-trace-time",  required_argument, 0, 't'},
+    {"log-level",       required_argument, 0, 'l'},
+    {"log-file",        required_argument, 0, 'f'},
+    {"dump-log",        required_argument, 0, 'd'},
+    {"dump-flight",     required_argument, 0, 'F'},
     {0, 0, 0, 0},
 };
 
-AnJaRootDaemon::AnJaRootDaemon() : showVersion(false), showUsage(false)
+AnJaRootDaemon::AnJaRootDaemon() : showVersion(false), showUsage(false),
+    dumpLogPath(0), dumpFlightPath(0),
+    signalFd(-1)
 {
 }
 
 AnJaRootDaemon::~AnJaRootDaemon()
 {
+    if(signalFd != -1)
+    {
+        close(signalFd);
+    }
 }
 
 void AnJaRootDaemon::printUsage(const char* progname) const
@@ -52,6 +67,34 @@ void AnJaRootDaemon::printUsage(const char* progname) const
     std::cerr << std::endl << "Valid Options:" << std::endl;
     std::cerr << "\t-h, --help\t\t\tprint this usage message" << std::endl;
     std::cerr << "\t-v, --version\t\t\tprint version" << std::endl;
+    std::cerr << "\t-s, --max-stops=N\t\tdetach from a child after N "
+        "stops (0 = never)" << std::endl;
+    std::cerr << "\t-t, --max-trace-time=MS\t\tdetach from a child after "
+        "MS milliseconds (0 = never)" << std::endl;
+    std::cerr << "\t-l, --log-level=SPEC\t\tlog levels, e.g. "
+        "\"info,hook=verbose\"" << std::endl;
+    std::cerr << "\t-f, --log-file=PATH\t\tlog to a ring file instead of "
+        "logcat" << std::endl;
+    std::cerr << "\t-d, --dump-log=PATH\t\tprint the ring file's lines and "
+        "exit" << std::endl;
+    std::cerr << "\t-F, --dump-flight=PATH\t\tprint a flight recorder dump "
+        "and exit" << std::endl;
+}
+
+bool AnJaRootDaemon::parseLimit(const char* arg, unsigned int& value) const
+{
+    char* end = 0;
+    errno = 0;
+    unsigned long parsed = strtoul(arg, &end, 10);
+    if(errno != 0 || end == arg || *end != '\0' || arg[0] == '-' ||
+            parsed > UINT_MAX)
+    {
+        util::logError("Invalid limit: %s", arg);
+        return false;
+    }
+
+    value = parsed;
+    return true;
 }
 
 void AnJaRootDaemon::processArguments(int argc, char** argv)
@@ -68,49 +111,82 @@ void AnJaRootDaemon::processArguments(int argc, char** argv)
         switch(c)
         {
             case 'v':
-                util::logVerbose("opt: -v");
+                LOGV(General, "opt: -v");
                 showVersion = true;
                 return;
+            case 's':
+                LOGV(General, "opt: -s %s", optarg);
+                if(!parseLimit(optarg, budget.maxStops))
+                {
+                    showUsage = true;
+                    return;
+                }
+                break;
+            case 't':
+                LOGV(General, "opt: -t %s", optarg);
+                if(!parseLimit(optarg, budget.maxMillis))
+                {
+                    showUsage = true;
+                    return;
+                }
+                break;
+            case 'l':
+                LOGV(General, "opt: -l %s", optarg);
+                if(!util::setLogLevels(optarg))
+                {
+                    showUsage = true;
+                    return;
+                }
+                break;
+            case 'f':
+                util::setupRingLogging(optarg);
+                LOGV(General, "opt: -f %s", optarg);
+                break;
+            case 'd':
+                LOGV(General, "opt: -d %s", optarg);
+                dumpLogPath = optarg;
+                return;
+            case 'F':
+                LOGV(General, "opt: -F %s", optarg);
+                dumpFlightPath = optarg;
+                return;
             case 'h':
             default:
-                util::logVerbose("opt: -h (or unknown)");
+                LOGV(General, "opt: -h (or unknown)");
                 showUsage = true;
                 return;
         }
     }
 }
 
-void AnJaRootDaemon::signalHandler(int signum)
+void AnJaRootDaemon::setupSignalHandling()
 {
-    // Zygote doesn't use the android logging methods in its signal handler, so
-    // we don't do either. It's just too risky...
-    if(signum == SIGINT || signum == SIGTERM)
-    {
-        shouldRun = false;
-        return;
-    }
-}
+    LOGV(General, "Setting up signal handling...");
 
-void AnJaRootDaemon::setupSignalHandling() const
-{
-    util::logVerbose("Setting up signal handlers...");
+    // Signals are read from a signalfd within the event loop, that's why
+    // they have to be blocked. This has to happen before any thread gets
+    // started or a tracee attached, a SIGCHLD must never get lost.
+    const int signals[] = {SIGCHLD, SIGINT, SIGTERM, SIGUSR1};
 
-    struct sigaction sa;
-    sigemptyset(&sa.sa_mask);
-    sa.sa_handler = AnJaRootDaemon::signalHandler;
-    sa.sa_flags = 0;
+    sigset_t mask;
+    sigemptyset(&mask);
+    for(std::size_t i = 0; i < sizeof(signals) / sizeof(signals[0]); i++)
+    {
+        sigaddset(&mask, signals[i]);
+    }
 
-    int ret = sigaction(SIGINT, &sa, NULL);
+    int ret = sigprocmask(SIG_BLOCK, &mask, NULL);
     if(ret == -1)
     {
-        util::logError("Failed to setup SIGINT handler: %s", strerror(errno));
+        util::logError("Failed to block signals: %s", strerror(errno));
         throw std::system_error(errno, std::system_category());
     }
 
-    ret = sigaction(SIGTERM, &sa, NULL);
-    if(ret == -1)
+    signalFd = reactor::openSignalFd(signals,
+            sizeof(signals) / sizeof(signals[0]));
+    if(signalFd == -1)
     {
-        util::logError("Failed to setup SIGTERM handler: %s", strerror(errno));
+        util::logError("Failed to create signalfd: %s", strerror(errno));
         throw std::system_error(errno, std::system_category());
     }
 }
@@ -167,10 +243,33 @@ int AnJaRootDaemon::run(int argc, char** argv)
         return 0;
     }
 
+    if(dumpLogPath)
+    {
+        if(!util::dumpRingLog(dumpLogPath, STDOUT_FILENO))
+        {
+            std::cerr << "Failed to dump " << dumpLogPath << ": " <<
+                strerror(errno) << std::endl;
+            return 1;
+        }
+        return 0;
+    }
+
+    if(dumpFlightPath)
+    {
+        if(!flight::print(dumpFlightPath, std::cout))
+        {
+            std::cerr << "Failed to read " << dumpFlightPath << ": " <<
+                strerror(errno) << std::endl;
+            return 1;
+        }
+        return 0;
+    }
+
     try
     {
         setupSignalHandling();
         claimLockSocket();
+        trace::probeDecoder();
     }
     catch(std::exception& e)
     {
@@ -178,56 +277,33 @@ int AnJaRootDaemon::run(int argc, char** argv)
         return 1;
     }
 
-    while(shouldRun)
+    flight::installCrashHandler(flight::CrashDumpPath);
+
+    // from here on the tracer thread shouldn't wait for log writes
+    util::startAsyncLogging();
+    policy::getPrefetcher().start();
+
+    int result = 0;
+    try
     {
-        try
-        {
-            ZygoteChildHandler zygoteChilds;
-            ZygoteHandler zygote(zygoteChilds);
-            DebuggerdHandler debuggerd;
-
-            bool handled = true;
-            while(shouldRun && handled)
-            {
-                trace::WaitResult res = trace::waitChilds();
-                if(errno == ECHILD)
-                {
-                    util::logVerbose("We have no children :(");
-                    res.logDebugInfo();
-                    handled = false;
-                }
-                else if(errno == EINTR)
-                {
-                    util::logVerbose("We got interrupted in wait()");
-                    handled = true;
-                }
-                else if(res.getPid() == zygote.getPid())
-                {
-                    handled = zygote.handle(res);
-                }
-                else if(res.getPid() == debuggerd.getPid())
-                {
-                    handled = debuggerd.handle(res);
-                }
-                else
-                {
-                    handled = zygoteChilds.handle(res);
-                }
-            }
-        }
-        catch(std::exception& e)
-        {
-            util::logError("Failed: %s", e.what());
-            sleep(1);
-        }
+        Supervisor supervisor(signalFd, budget);
+        supervisor.run();
+    }
+    catch(std::exception& e)
+    {
+        util::logError("Failed: %s", e.what());
+        result = 1;
     }
 
-    return 0;
+    policy::getPrefetcher().stop();
+    stats::dump();
+    util::stopAsyncLogging();
+    return result;
 }
 
 int main(int argc, char** argv)
 {
-    util::logVerbose("AnJaRootDaemon (version %s) started",
+    LOGV(General, "AnJaRootDaemon (version %s) started",
             version::asString().c_str());
 
     return AnJaRootDaemon().run(argc, argv);
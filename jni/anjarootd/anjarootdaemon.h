@@ -22,6 +22,8 @@
 
 #include <getopt.h>
 
+#include "zygotechildhandler.h"
+
 class AnJaRootDaemon
 {
     public:
@@ -33,17 +35,19 @@ class AnJaRootDaemon
     private:
         static const char* shortopts;
         static const option longopts[];
-        static bool shouldRun;
-
-        static void signalHandler(int signum);
 
         void printUsage(const char* progname) const;
         void processArguments(int argc, char** argv);
         void claimLockSocket() const;
-        void setupSignalHandling() const;
+        void setupSignalHandling();
+        bool parseLimit(const char* arg, unsigned int& value) const;
 
         bool showVersion;
         bool showUsage;
+        const char* dumpLogPath;
+        const char* dumpFlightPath;
+        int signalFd;
+        ZygoteChildHandler::Budget budget;
 };
 
 #endif
@@ -0,0 +1,118 @@
+/*
+ * Copyright 2013 Simon Brakhane
+ *
+ * This file is part of AnJaRoot.
+ *
+ * AnJaRoot is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * AnJaRoot is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * AnJaRoot. If not, see http://www.gnu.org/licenses/.
+ */
+
+#ifndef _ANJAROOTD_ARCH_ARM_TRAITS_H_
+#define _ANJAROOTD_ARCH_ARM_TRAITS_H_
+
+#include <system_error>
+#include <string.h>
+
+#include "shared/util.h"
+
+#ifndef __NR_process_vm_readv
+#define __NR_process_vm_readv 376
+#endif
+
+#ifndef __NR_process_vm_writev
+#define __NR_process_vm_writev 377
+#endif
+
+namespace arch
+{
+    template<>
+    struct Traits<Arm>
+    {
+        typedef struct pt_regs Registers;
+
+        static bool fetchRegisters(pid_t pid, Registers& regs, bool regset)
+        {
+            if(regset && fetchRegset(pid, regs))
+            {
+                return true;
+            }
+
+            return ptrace(PTRACE_GETREGS, pid, NULL, (void*)&regs) != -1;
+        }
+
+        static bool isSyscallEntry(const Registers& regs)
+        {
+            // the kernel marks entry stops with ip == 0, exits with ip == 1
+            return regs.ARM_ip == 0;
+        }
+
+        static long getSyscallNumber(pid_t pid, const Registers& regs)
+        {
+            // This function is a copy from strace (syscall.c), adopted to our
+            // needs.
+            long syscallnum = -1;
+            if(regs.ARM_cpsr & 0x20)
+            {
+                // Get the Thumb-mode system call number
+                syscallnum = regs.ARM_r7;
+            }
+            else
+            {
+                //Get the ARM-mode system call number
+                errno = 0;
+                syscallnum = ptrace(PTRACE_PEEKTEXT, pid,
+                        (void *)(regs.ARM_pc - 4), NULL);
+                if(errno)
+                {
+                    util::logError("Failed to get registers, err %d: %s",
+                            errno, strerror(errno));
+                    throw std::system_error(errno, std::system_category());
+                }
+
+                if(syscallnum == 0xef000000)
+                {
+                    syscallnum = regs.ARM_r7;
+                }
+                else
+                {
+                    if((syscallnum & 0x0ff00000) != 0x0f900000)
+                    {
+                        util::logError("unknown syscall trap 0x%08lx\n",
+                                syscallnum);
+                        throw std::system_error(syscallnum,
+                                std::generic_category());
+                    }
+
+                    // Fixup the syscall number
+                    syscallnum &= 0x000fffff;
+                }
+            }
+
+            if(syscallnum & 0x0f0000)
+            {
+                // Handle ARM specific syscall
+                syscallnum &= 0x0000ffff;
+            }
+
+            return syscallnum;
+        }
+
+        static long getArg(const Registers& regs, int index)
+        {
+            return regs.uregs[index];
+        }
+
+    };
+}
+
+#endif
@@ -0,0 +1,87 @@
+/*
+ * Copyright 2013 Simon Brakhane
+ *
+ * This file is part of AnJaRoot.
+ *
+ * AnJaRoot is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * AnJaRoot is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * AnJaRoot. If not, see http://www.gnu.org/licenses/.
+ */
+
+#ifndef _ANJAROOTD_ARCH_MIPS_TRAITS_H_
+#define _ANJAROOTD_ARCH_MIPS_TRAITS_H_
+
+#include <stdint.h>
+
+#ifndef __NR_process_vm_readv
+#define __NR_process_vm_readv 4345
+#endif
+
+#ifndef __NR_process_vm_writev
+#define __NR_process_vm_writev 4346
+#endif
+
+namespace arch
+{
+    // Layout of PTRACE_GETREGS on MIPS, every register is stored as 64bit
+    // value, even on 32bit kernels.
+    struct MipsRegisters
+    {
+        uint64_t regs[32];
+        uint64_t lo;
+        uint64_t hi;
+        uint64_t cp0_epc;
+        uint64_t cp0_badvaddr;
+        uint64_t cp0_status;
+        uint64_t cp0_cause;
+    };
+
+    template<>
+    struct Traits<Mips>
+    {
+        typedef MipsRegisters Registers;
+
+        enum
+        {
+            RegV0 = 2,
+            RegA0 = 4,
+        };
+
+        // The NT_PRSTATUS regset uses a different layout (and needs a newer
+        // kernel), so we stick with PTRACE_GETREGS here.
+        static bool fetchRegisters(pid_t pid, Registers& regs, bool regset)
+        {
+            return ptrace(PTRACE_GETREGS, pid, NULL, (void*)&regs) != -1;
+        }
+
+        static bool isSyscallEntry(const Registers& regs)
+        {
+            // nothing tells entries and exits apart, the caller has to
+            return true;
+        }
+
+        static long getSyscallNumber(pid_t pid, const Registers& regs)
+        {
+            return regs.regs[RegV0];
+        }
+
+        static long getArg(const Registers& regs, int index)
+        {
+            // o32 passes the first four arguments in a0-a3, the rest lives on
+            // the stack, which we don't need so far
+            return index < 4 ? regs.regs[RegA0 + index] : 0;
+        }
+
+    };
+}
+
+#endif
@@ -0,0 +1,77 @@
+/*
+ * Copyright 2013 Simon Brakhane
+ *
+ * This file is part of AnJaRoot.
+ *
+ * AnJaRoot is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * AnJaRoot is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * AnJaRoot. If not, see http://www.gnu.org/licenses/.
+ */
+
+#ifndef _ANJAROOTD_ARCH_X86_TRAITS_H_
+#define _ANJAROOTD_ARCH_X86_TRAITS_H_
+
+#include <linux/user.h>
+
+#ifndef __NR_process_vm_readv
+#define __NR_process_vm_readv 347
+#endif
+
+#ifndef __NR_process_vm_writev
+#define __NR_process_vm_writev 348
+#endif
+
+namespace arch
+{
+    template<>
+    struct Traits<X86>
+    {
+        typedef struct user_regs_struct Registers;
+
+        static bool fetchRegisters(pid_t pid, Registers& regs, bool regset)
+        {
+            if(regset && fetchRegset(pid, regs))
+            {
+                return true;
+            }
+
+            return ptrace(PTRACE_GETREGS, pid, NULL, (void*)&regs) != -1;
+        }
+
+        static bool isSyscallEntry(const Registers& regs)
+        {
+            // nothing tells entries and exits apart, the caller has to
+            return true;
+        }
+
+        static long getSyscallNumber(pid_t pid, const Registers& regs)
+        {
+            return regs.orig_eax;
+        }
+
+        static long getArg(const Registers& regs, int index)
+        {
+            switch(index)
+            {
+                case 0: return regs.ebx;
+                case 1: return regs.ecx;
+                case 2: return regs.edx;
+                case 3: return regs.esi;
+                case 4: return regs.edi;
+                default: return regs.ebp;
+            }
+        }
+
+    };
+}
+
+#endif
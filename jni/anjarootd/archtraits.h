@@ -0,0 +1,89 @@
+/*
+ * Copyright 2013 Simon Brakhane
+ *
+ * This file is part of AnJaRoot.
+ *
+ * AnJaRoot is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * AnJaRoot is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * AnJaRoot. If not, see http://www.gnu.org/licenses/.
+ */
+
+#ifndef _ANJAROOTD_ARCHTRAITS_H_
+#define _ANJAROOTD_ARCHTRAITS_H_
+
+#include <errno.h>
+#include <elf.h>
+#include <sys/ptrace.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#ifndef PTRACE_GETREGSET
+#define PTRACE_GETREGSET 0x4204
+#endif
+
+#ifndef NT_PRSTATUS
+#define NT_PRSTATUS 1
+#endif
+
+// Everything the daemon needs to know about a cpu lives in a specialisation of
+// arch::Traits, placed in the arch-xxx directories. A specialisation has to
+// provide:
+//
+//  Registers             the register set, as fetched by fetchRegisters()
+//  fetchRegisters()      read the registers of a stopped tracee, through
+//                        PTRACE_GETREGSET if the caller says it's supported
+//  isSyscallEntry()      false if the registers prove we are in a syscall exit
+//  getSyscallNumber()    number of the syscall in an entry stop
+//  getArg()              syscall arguments, by index
+//
+// Adding an architecture means adding a specialisation, nothing else.
+namespace arch
+{
+    struct Arm {};
+    struct X86 {};
+    struct Mips {};
+
+    template<typename Arch>
+    struct Traits;
+
+    // PTRACE_GETREGSET is the generic way, but not every kernel supports it
+    // for every architecture. Returns false with errno set on failure.
+    template<typename Registers>
+    bool fetchRegset(pid_t pid, Registers& regs)
+    {
+        struct iovec iov;
+        iov.iov_base = &regs;
+        iov.iov_len = sizeof(regs);
+        return ptrace(PTRACE_GETREGSET, pid, (void*)NT_PRSTATUS, &iov) != -1;
+    }
+}
+
+#if defined(__arm__)
+#include "arch-arm/traits.h"
+namespace arch { typedef Arm Native; }
+#elif defined(__i386__)
+#include "arch-x86/traits.h"
+namespace arch { typedef X86 Native; }
+#elif defined(__mips__)
+#include "arch-mips/traits.h"
+namespace arch { typedef Mips Native; }
+#else
+#error "Unsupported architecture"
+#endif
+
+namespace arch
+{
+    typedef Traits<Native> NativeTraits;
+    typedef NativeTraits::Registers Registers;
+}
+
+#endif
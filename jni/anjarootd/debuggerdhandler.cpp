@@ -18,6 +18,7 @@
  */
 #include <system_error>
 
+#include <signal.h>
 #include <unistd.h>
 
 #include "debuggerdhandler.h"
@@ -30,6 +31,12 @@ DebuggerdHandler::DebuggerdHandler() : pid(0)
     pid = fork();
     if(pid == 0)
     {
+        // we block a few signals to read them from a signalfd, debuggerd
+        // must not inherit that
+        sigset_t empty;
+        sigemptyset(&empty);
+        sigprocmask(SIG_SETMASK, &empty, NULL);
+
         execl(executablePath, executablePath, NULL);
 
         // if we land here, exec failed...
@@ -42,14 +49,14 @@ DebuggerdHandler::DebuggerdHandler() : pid(0)
         throw std::system_error(errno, std::system_category());
     }
 
-    util::logVerbose("Spawned debuggerd with pid %d", pid);
+    LOGV(General, "Spawned debuggerd with pid %d", pid);
 }
 
 DebuggerdHandler::~DebuggerdHandler()
 {
     if(pid < 1)
     {
-        util::logVerbose("Can't kill debuggerd - we have no pid");
+        LOGV(General, "Can't kill debuggerd - we have no pid");
         return;
     }
 
@@ -68,7 +75,16 @@ pid_t DebuggerdHandler::getPid() const
 
 bool DebuggerdHandler::handle(const trace::WaitResult& res)
 {
+    if(!res.hasExited() && !res.wasSignaled())
+    {
+        // not traced, so there shouldn't be anything else, but who knows
+        return true;
+    }
+
     util::logError("debuggerd exited");
     res.logDebugInfo();
+
+    // it's gone, don't SIGTERM whoever gets the pid next
+    pid = 0;
     return false;
 }
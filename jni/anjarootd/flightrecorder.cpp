@@ -0,0 +1,289 @@
+/*
+ * Copyright 2013 Simon Brakhane
+ *
+ * This file is part of AnJaRoot.
+ *
+ * AnJaRoot is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * AnJaRoot is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * AnJaRoot. If not, see http://www.gnu.org/licenses/.
+ */
+
+#include <string>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "flightrecorder.h"
+#include "monotonic.h"
+#include "shared/util.h"
+
+const char* flight::DumpPath = "/data/misc/anjaroot/flightrecorder";
+const char* flight::CrashDumpPath = "/data/misc/anjaroot/flightrecorder.crash";
+
+namespace
+{
+    struct DumpHeader
+    {
+        static const uint32_t Magic = 0x52464a41; // "AJFR"
+        static const uint32_t Version = 1;
+
+        uint32_t magic;
+        uint32_t version;
+        uint32_t recordSize;
+        uint32_t capacity;
+        // records ever taken, the ring holds the last capacity of them
+        uint64_t count;
+    };
+}
+
+// 128KB, about a minute of a busy launch storm
+static const uint32_t Capacity = 4096;
+
+static flight::Record records[Capacity];
+static uint64_t recordCount = 0;
+static flight::Record* current = 0;
+static int crashFd = -1;
+
+static const int crashSignals[] = {SIGSEGV, SIGBUS, SIGILL, SIGFPE, SIGABRT};
+static struct sigaction previousActions[sizeof(crashSignals) /
+    sizeof(crashSignals[0])];
+
+void flight::begin(pid_t pid, int status)
+{
+    Record* record = &records[recordCount++ % Capacity];
+    record->timestamp = monotonic::nowNs();
+    record->pid = pid;
+    record->status = status;
+    record->syscall = -1;
+    record->latency = 0;
+    record->event = (status >> 16) & 0xff;
+    record->decision = NoDecision;
+    current = record;
+}
+
+void flight::noteSyscall(long number)
+{
+    if(current)
+    {
+        current->syscall = number;
+    }
+}
+
+void flight::noteDecision(Decision decision)
+{
+    if(current)
+    {
+        current->decision = decision;
+    }
+}
+
+void flight::end()
+{
+    if(current)
+    {
+        current->latency = monotonic::nowNs() - current->timestamp;
+        current = 0;
+    }
+}
+
+// Only async-signal-safe calls in here, it runs from the crash handler. The
+// size is always the same, so the crash dump can be rewritten in place.
+static bool writeDump(int fd)
+{
+    DumpHeader header;
+    memset(&header, 0, sizeof(header));
+    header.magic = DumpHeader::Magic;
+    header.version = DumpHeader::Version;
+    header.recordSize = sizeof(flight::Record);
+    header.capacity = Capacity;
+    header.count = recordCount;
+
+    // oldest first, which is where the next record goes once we wrapped
+    uint32_t start = recordCount < Capacity ? 0 : recordCount % Capacity;
+    const char* base = reinterpret_cast<const char*>(records);
+    std::size_t split = start * sizeof(flight::Record);
+    std::size_t total = sizeof(records);
+
+    return pwrite(fd, &header, sizeof(header), 0) == sizeof(header) &&
+        pwrite(fd, base + split, total - split, sizeof(header)) ==
+            static_cast<ssize_t>(total - split) &&
+        pwrite(fd, base, split, sizeof(header) + total - split) ==
+            static_cast<ssize_t>(split);
+}
+
+static void crashHandler(int signum)
+{
+    if(crashFd != -1)
+    {
+        writeDump(crashFd);
+        fsync(crashFd);
+    }
+
+    // the signal is blocked till we return, so this hands it over to
+    // whoever had it before
+    for(std::size_t i = 0; i < sizeof(crashSignals) / sizeof(crashSignals[0]);
+            i++)
+    {
+        if(crashSignals[i] == signum)
+        {
+            sigaction(signum, &previousActions[i], NULL);
+        }
+    }
+    raise(signum);
+}
+
+// we share the directory with the policy snapshot, whoever comes first
+// creates it
+static int openDump(const char* path, int flags)
+{
+    std::string name(path);
+    std::string dir = name.substr(0, name.rfind('/'));
+    if(mkdir(dir.c_str(), 0700) == -1 && errno != EEXIST)
+    {
+        return -1;
+    }
+
+    return open(path, flags | O_WRONLY | O_CREAT | O_CLOEXEC, 0600);
+}
+
+bool flight::dump(const char* path)
+{
+    int fd = openDump(path, O_TRUNC);
+    if(fd == -1)
+    {
+        util::logError("Failed to open %s: %s", path, strerror(errno));
+        return false;
+    }
+
+    bool result = writeDump(fd);
+    if(!result)
+    {
+        util::logError("Failed to write %s: %s", path, strerror(errno));
+    }
+
+    close(fd);
+    return result;
+}
+
+void flight::installCrashHandler(const char* path)
+{
+    // not truncated, that would lose the dump of the last crash
+    crashFd = openDump(path, 0);
+    if(crashFd == -1)
+    {
+        util::logError("Failed to open %s: %s", path, strerror(errno));
+        return;
+    }
+
+    // a stack overflow leaves no stack to run the handler on
+    static char altStack[16 * 1024];
+    stack_t ss;
+    memset(&ss, 0, sizeof(ss));
+    ss.ss_sp = altStack;
+    ss.ss_size = sizeof(altStack);
+    if(sigaltstack(&ss, NULL) == -1)
+    {
+        util::logError("Failed to set signal stack: %s", strerror(errno));
+    }
+
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = crashHandler;
+    action.sa_flags = SA_ONSTACK;
+    sigemptyset(&action.sa_mask);
+
+    for(std::size_t i = 0; i < sizeof(crashSignals) / sizeof(crashSignals[0]);
+            i++)
+    {
+        if(sigaction(crashSignals[i], &action, &previousActions[i]) == -1)
+        {
+            util::logError("Failed to handle signal %d: %s", crashSignals[i],
+                    strerror(errno));
+        }
+    }
+}
+
+static const char* getDecisionName(uint8_t decision)
+{
+    switch(decision)
+    {
+        case flight::NoDecision:
+            return "-";
+        case flight::Granted:
+            return "granted";
+        case flight::Denied:
+            return "denied";
+        case flight::FastDetached:
+            return "fast-detached";
+        case flight::BudgetExceeded:
+            return "budget-exceeded";
+        case flight::Exited:
+            return "exited";
+        default:
+            return "?";
+    }
+}
+
+bool flight::print(const char* path, std::ostream& out)
+{
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if(fd == -1)
+    {
+        return false;
+    }
+
+    DumpHeader header;
+    if(read(fd, &header, sizeof(header)) != sizeof(header) ||
+            header.magic != DumpHeader::Magic ||
+            header.version != DumpHeader::Version ||
+            header.recordSize != sizeof(Record))
+    {
+        close(fd);
+        errno = EINVAL;
+        return false;
+    }
+
+    char line[160];
+    snprintf(line, sizeof(line), "%llu records taken, last %u kept\n",
+            static_cast<unsigned long long>(header.count), header.capacity);
+    out << line;
+    out << "timestamp(ns)        pid      status     event syscall  "
+        "latency(ns) decision\n";
+
+    Record record;
+    for(uint32_t i = 0; i < header.capacity; i++)
+    {
+        if(read(fd, &record, sizeof(record)) != sizeof(record))
+        {
+            break;
+        }
+
+        if(record.timestamp == 0)
+        {
+            continue;
+        }
+
+        snprintf(line, sizeof(line), "%-20llu %-8d 0x%08x %-5u %-8d %-11u "
+                "%s\n", static_cast<unsigned long long>(record.timestamp),
+                record.pid, record.status, record.event, record.syscall,
+                record.latency, getDecisionName(record.decision));
+        out << line;
+    }
+
+    close(fd);
+    return true;
+}
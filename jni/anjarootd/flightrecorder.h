@@ -0,0 +1,94 @@
+/*
+ * Copyright 2013 Simon Brakhane
+ *
+ * This file is part of AnJaRoot.
+ *
+ * AnJaRoot is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * AnJaRoot is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * AnJaRoot. If not, see http://www.gnu.org/licenses/.
+ */
+
+#ifndef _ANJAROOTD_FLIGHTRECORDER_H_
+#define _ANJAROOTD_FLIGHTRECORDER_H_
+
+#include <ostream>
+#include <stdint.h>
+#include <sys/types.h>
+
+// Always on record of the last events the daemon handled and what it decided,
+// for finding out what happened after the fact. Recording is a couple of
+// stores plus reading the (vdso) clock, unlike text logging it can stay on.
+// Only the tracer thread records.
+namespace flight
+{
+    enum Decision
+    {
+        NoDecision,
+        Granted,
+        Denied,
+        FastDetached,
+        BudgetExceeded,
+        Exited,
+    };
+
+    struct Record
+    {
+        // CLOCK_MONOTONIC in ns when the event got picked up, 0 if unused
+        uint64_t timestamp;
+        int32_t pid;
+        int32_t status;
+        // -1 if none was looked at
+        int32_t syscall;
+        // ns spent handling the event
+        uint32_t latency;
+        uint8_t event;
+        uint8_t decision;
+        uint8_t reserved[6];
+    };
+
+    // written on SIGUSR1, and on a crash respectively
+    extern const char* DumpPath;
+    extern const char* CrashDumpPath;
+
+    void begin(pid_t pid, int status);
+    void noteSyscall(long number);
+    void noteDecision(Decision decision);
+    void end();
+
+    // records one event for as long as it's in scope
+    class Scope
+    {
+        public:
+            Scope(pid_t pid, int status)
+            {
+                begin(pid, status);
+            }
+
+            ~Scope()
+            {
+                end();
+            }
+
+        private:
+            Scope(const Scope&);
+            Scope& operator=(const Scope&);
+    };
+
+    bool dump(const char* path);
+    // dumps to path on fatal signals before the previous handler (debuggerd's)
+    // gets its turn
+    void installCrashHandler(const char* path);
+    // prints a dump as text, oldest record first
+    bool print(const char* path, std::ostream& out);
+}
+
+#endif
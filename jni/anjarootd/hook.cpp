@@ -20,32 +20,40 @@
 
 #include <asm/unistd.h>
 #include <errno.h>
+#include <string.h>
 #include <sys/stat.h>
 
 #include "hook.h"
-#include "packages.h"
+#include "flightrecorder.h"
+#include "policy.h"
+#include "stats.h"
 #include "shared/util.h"
 
-// functions which require plarform dependant code (like getSyscallNumber) are
-// implemented in the arch-xxx directories and build as needed. Only
-// independant stuff is placed here.
-//
+// Platform dependant bits (register layout, syscall numbering, ...) are
+// described by the arch::Traits specialisations in the arch-xxx directories,
+// the code here is written against those only.
+typedef arch::NativeTraits Traits;
 
 // TODO make this package name configureable at buildtime, people would want to
 // change it to enable custom builds without source changes
 const char* hook::GranterPackageName = "org.failedprojects.anjaroot";
 
+static stats::Counter detachedIsolated("fast detach: isolated");
+static stats::Counter detachedNotGranted("fast detach: not granted");
+static stats::Counter detachedNoGrants("fast detach: no grants");
+
 uid_t hook::getUidFromPid(pid_t pid)
 {
+    // Only the fallback if we never saw the child's setuid call, see
+    // performSetUidActions.
+    //
     // Why this works:
     //
     // If we take a look at dalvik_system_Zygote.cpp, within the dalvik
     // repository in vm/native, one can see that the forkAndSpecializeCommon
     // method does call set(res)uid before capset. So the uid already changed,
-    // it's save to read it that way. We could also trace the syscall which
-    // sets the uid in the new zygote child, but it's not worth all the
-    // platform specific code one has to write. So we just read the uid from
-    // /proc/<pid> as those files are owned by the process uid.
+    // it's save to read it that way. We just read the uid from /proc/<pid> as
+    // those files are owned by the process uid.
     char path[32] = {0, };
     snprintf(path, sizeof(path), "/proc/%d", pid);
 
@@ -62,58 +70,212 @@ uid_t hook::getUidFromPid(pid_t pid)
 
 bool hook::isUidGranted(uid_t uid)
 {
-    packages::PackageList pkgs;
-    const packages::Package* anjaroot = pkgs.findByName(GranterPackageName);
+    return policy::getGrantCache().isUidGranted(uid);
+}
 
-    if(anjaroot == NULL)
+bool hook::hasGrants()
+{
+    return policy::getGrantCache().hasGrants();
+}
+
+// Has to give the same answer performCapsetActions would give later on, it
+// only saves the stops in between.
+hook::DetachReason hook::checkFastDetach(uid_t uid)
+{
+    // android.os.Process FIRST_ISOLATED_UID and LAST_ISOLATED_UID
+    uid_t appId = uid % policy::PerUserRange;
+    if(appId >= 99000 && appId <= 99999)
     {
-        util::logError("Couldn't get anjaroot package");
-        return false;
+        return DetachIsolated;
     }
 
-    const packages::Package* target = pkgs.findByUid(uid);
-    if(target == NULL)
+    if(!isUidGranted(uid))
     {
-        util::logError("Couldn't get target package");
-        return false;
+        return DetachNotGranted;
     }
 
-    packages::GrantedPackageList granter(*anjaroot);
-    return granter.isGranted(*target);
+    return KeepTracing;
+}
+
+void hook::recordFastDetach(DetachReason reason)
+{
+    flight::noteDecision(flight::FastDetached);
+    switch(reason)
+    {
+        case DetachIsolated:
+            detachedIsolated.add();
+            break;
+        case DetachNotGranted:
+            detachedNotGranted.add();
+            break;
+        case DetachNoGrants:
+            detachedNoGrants.add();
+            break;
+        default:
+            break;
+    }
 }
 
-// TODO we don't have logmsgs here on purpose, it would result in major
-// spam with little information at all. A cmdline switch or environment
-// variable would be nice to have for enabling otherwise disabled log lines
+// Runs for every syscall stop, so the logging here goes to the syscall
+// subsystem which is off unless asked for (ANJAROOT_LOG=syscall=verbose).
 //
 // we return true if the caller can now detach from the tracee
-bool hook::performHookActions(trace::Tracee::Ptr tracee)
+bool hook::performHookActions(trace::Tracee::Ptr tracee, long& syscallnum)
 {
-    long syscallnum = getSyscallNumber(tracee);
+    syscallnum = getSyscallNumber(tracee);
+    flight::noteSyscall(syscallnum);
     if(syscallnum == -1)
     {
-        // TODO create conditional logging for this case (syscall exit)
+        LOGV(Syscall, "Syscall exit of %d", tracee->getPid());
         return false;
     }
 
+    LOGV(Syscall, "Syscall %ld entered by %d", syscallnum, tracee->getPid());
+
     if(syscallnum == __NR_capset)
     {
-        uid_t uid = getUidFromPid(tracee->getPid());
-        bool granted = isUidGranted(uid);
-        if(granted)
-        {
-            util::logVerbose("Child with pid %d is a target, "
-                    "changing capabilities", tracee->getPid());
-            changePermittedCapabilities(tracee);
-        }
-        else
-        {
-            util::logVerbose("Child with pid %d is not a target, "
-                    "no action performed", tracee->getPid());
-        }
+        return performCapsetActions(tracee);
+    }
 
-        return true;
+    if(isSetUidSyscall(syscallnum))
+    {
+        performSetUidActions(tracee, syscallnum);
     }
 
     return false;
 }
+
+// the tracee has to sit in the syscall entry stop of capset
+bool hook::performCapsetActions(trace::Tracee::Ptr tracee)
+{
+    uid_t uid = tracee->hasTracedUid() ? tracee->getTracedUid() :
+        getUidFromPid(tracee->getPid());
+    bool granted = isUidGranted(uid);
+    flight::noteDecision(granted ? flight::Granted : flight::Denied);
+    tracee->getTimeline().outcome = granted ? trace::Tracee::Granted :
+        trace::Tracee::Denied;
+    if(granted)
+    {
+        LOGV(Hook, "Child with pid %d is a target, "
+                "changing capabilities", tracee->getPid());
+        changePermittedCapabilities(tracee);
+    }
+    else
+    {
+        LOGV(Hook, "Child with pid %d is not a target, "
+                "no action performed", tracee->getPid());
+    }
+
+    return true;
+}
+
+bool hook::isSetUidSyscall(long syscallnum)
+{
+    switch(syscallnum)
+    {
+        case __NR_setuid:
+        case __NR_setresuid:
+#ifdef __NR_setuid32
+        case __NR_setuid32:
+#endif
+#ifdef __NR_setresuid32
+        case __NR_setresuid32:
+#endif
+            return true;
+        default:
+            return false;
+    }
+}
+
+// Called on the entry of a setuid family call, in a syscall stop we hold
+// while tracing with PTRACE_SYSCALL. Nothing is left behind in the child, if
+// we miss the call performCapsetActions just asks /proc instead. We can't see
+// the result from here, but forkAndSpecializeCommon aborts the child if it
+// fails anyway. The effective uid is the one owning /proc/<pid>, so that's
+// what we remember.
+void hook::performSetUidActions(trace::Tracee::Ptr tracee, long syscallnum)
+{
+    bool resuid = syscallnum == __NR_setresuid;
+#ifdef __NR_setresuid32
+    resuid = resuid || syscallnum == __NR_setresuid32;
+#endif
+
+    uid_t euid = getSyscallArg(tracee, resuid ? 1 : 0);
+    if(euid == static_cast<uid_t>(-1))
+    {
+        // setresuid leaves -1 untouched
+        return;
+    }
+
+    tracee->setTracedUid(euid);
+}
+
+int hook::getSyscallNumber(trace::Tracee::Ptr tracee)
+{
+    if(trace::getDecoder() == trace::DecodeSyscallInfo)
+    {
+        // the kernel tells us whether it's an entry, no guessing needed
+        const trace::SyscallInfo& info = tracee->getSyscallInfo();
+        return info.op == trace::SyscallInfo::Entry ? info.number : -1;
+    }
+
+    // We only get told that the tracee stopped in a syscall, not whether it
+    // is the entry or the exit. Stops alternate, so we keep track of it.
+    if(tracee->isSyscallBegin())
+    {
+        tracee->setSyscallBegin(false);
+        return -1;
+    }
+
+    const arch::Registers& regs = tracee->getRegisters();
+
+    // we are only interested in syscall entries
+    if(!Traits::isSyscallEntry(regs))
+    {
+        // signal syscall exit, we should never end here
+        util::logError("Expected syscall entry of %d, got exit",
+                tracee->getPid());
+        return -1;
+    }
+
+    tracee->setSyscallBegin(true);
+    return Traits::getSyscallNumber(tracee->getPid(), regs);
+}
+
+unsigned long hook::getSyscallArg(trace::Tracee::Ptr tracee, int n)
+{
+    if(trace::getDecoder() == trace::DecodeSyscallInfo)
+    {
+        return tracee->getSyscallInfo().args[n];
+    }
+
+    return Traits::getArg(tracee->getRegisters(), n);
+}
+
+bool hook::changePermittedCapabilities(trace::Tracee::Ptr tracee)
+{
+    // arg0 holds the addr of the cap_user_header_t*, we don't care about it
+    // here - we naivly trust that the syscall would succeed.
+    // arg1 holds the addr of the cap_user_data_t*, which is defined as (on
+    // every supported arch):
+    //
+    // typedef struct __user_cap_data_struct {
+    //     __u32 effective;
+    //     __u32 permitted;
+    //     __u32 inheritable;
+    // } *cap_user_data_t;
+    //
+    // Only the permitted field gets written, the neighbours stay untouched.
+    unsigned long dataaddr = getSyscallArg(tracee, 1);
+
+    __u32 permitted = 0xFFFFFEFF;
+    if(!tracee->writeMemory(dataaddr + sizeof(__u32), &permitted,
+                sizeof(permitted)))
+    {
+        util::logError("Failed to set permitted value of %d",
+                tracee->getPid());
+        return false;
+    }
+
+    return true;
+}
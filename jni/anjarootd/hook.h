@@ -24,13 +24,32 @@
 
 namespace hook
 {
+    // why a child may be dropped before its capset
+    enum DetachReason
+    {
+        KeepTracing,
+        // isolated processes never get anything
+        DetachIsolated,
+        // the policy doesn't grant this uid
+        DetachNotGranted,
+        // the policy doesn't grant anybody
+        DetachNoGrants,
+    };
+
     extern const char* GranterPackageName;
 
-    bool performHookActions(trace::Tracee::Ptr tracee);
+    bool performHookActions(trace::Tracee::Ptr tracee, long& syscallnum);
+    bool performCapsetActions(trace::Tracee::Ptr tracee);
+    void performSetUidActions(trace::Tracee::Ptr tracee, long syscallnum);
+    bool isSetUidSyscall(long syscallnum);
     int getSyscallNumber(trace::Tracee::Ptr tracee);
+    unsigned long getSyscallArg(trace::Tracee::Ptr tracee, int n);
     bool changePermittedCapabilities(trace::Tracee::Ptr tracee);
     uid_t getUidFromPid(pid_t pid);
     bool isUidGranted(uid_t uid);
+    bool hasGrants();
+    DetachReason checkFastDetach(uid_t uid);
+    void recordFastDetach(DetachReason reason);
 }
 
 #endif
@@ -0,0 +1,54 @@
+/*
+ * Copyright 2013 Simon Brakhane
+ *
+ * This file is part of AnJaRoot.
+ *
+ * AnJaRoot is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * AnJaRoot is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * AnJaRoot. If not, see http://www.gnu.org/licenses/.
+ */
+
+#ifndef _ANJAROOTD_MONOTONIC_H_
+#define _ANJAROOTD_MONOTONIC_H_
+
+#include <time.h>
+
+namespace monotonic
+{
+    // CLOCK_MONOTONIC, which is all the daemon ever measures with. It's a
+    // vDSO call and async-signal-safe, so it's fine in the hot path and in
+    // signal handlers alike.
+    inline long long nowNs()
+    {
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+    }
+
+    inline long long nowUs()
+    {
+        return nowNs() / 1000;
+    }
+
+    inline long long nowMs()
+    {
+        return nowNs() / 1000000;
+    }
+
+    // to - from, 0 if they are out of order
+    inline unsigned long long elapsed(long long from, long long to)
+    {
+        return to > from ? to - from : 0;
+    }
+}
+
+#endif
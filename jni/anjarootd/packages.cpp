@@ -19,109 +19,248 @@
 
 #include "packages.h"
 
-#include <stdlib.h>
 #include <exception>
-#include <iostream>
-#include <sstream>
 #include <fstream>
 
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
 #include "shared/util.h"
 
 
 namespace packages {
 
+StringRef::StringRef() : data(NULL), length(0)
+{
+}
+
+StringRef::StringRef(const char* data_, size_t length_)
+    : data(data_), length(length_)
+{
+}
+
+bool StringRef::operator==(const StringRef& other) const
+{
+    return length == other.length && memcmp(data, other.data, length) == 0;
+}
+
+bool StringRef::operator==(const std::string& other) const
+{
+    return length == other.size() && memcmp(data, other.data(), length) == 0;
+}
+
+std::string StringRef::str() const
+{
+    return std::string(data, length);
+}
+
+size_t StringRefHash::operator()(const StringRef& ref) const
+{
+    // FNV-1a, good enough for package names
+    size_t hash = 2166136261u;
+    for(size_t i = 0; i < ref.length; i++)
+    {
+        hash ^= static_cast<unsigned char>(ref.data[i]);
+        hash *= 16777619u;
+    }
+
+    return hash;
+}
+
 Package::Package() : uid(-1), debugFlag(false)
 {
 }
 
-PackageList::PackageList()
+PackageList::PackageList() : mapping(NULL), mappingSize(0)
 {
     readPackages();
 }
 
+PackageList::~PackageList()
+{
+    if(mapping != NULL)
+    {
+        munmap(mapping, mappingSize);
+    }
+}
+
 void PackageList::readPackages()
 {
-    try
+    const char* path = "/data/system/packages.list";
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if(fd == -1)
     {
-        std::ifstream file("/data/system/packages.list");
-        std::string line;
+        util::logError("Failed to open %s: %s", path, strerror(errno));
+        return;
+    }
 
-        while(std::getline(file, line))
+    struct stat st;
+    if(fstat(fd, &st) == -1)
+    {
+        util::logError("Failed to stat %s: %s", path, strerror(errno));
+        close(fd);
+        return;
+    }
+
+    // mmap refuses empty mappings
+    if(st.st_size == 0)
+    {
+        close(fd);
+        return;
+    }
+
+    void* addr = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if(addr == MAP_FAILED)
+    {
+        util::logError("Failed to map %s: %s", path, strerror(errno));
+        return;
+    }
+
+    mapping = addr;
+    mappingSize = st.st_size;
+
+    const char* data = static_cast<const char*>(mapping);
+    const char* end = data + mappingSize;
+
+    // A line is somewhere around 60 bytes, reserving too much is cheaper
+    // than rehashing a few times
+    size_t estimate = mappingSize / 48 + 1;
+    packages.reserve(estimate);
+    byName.reserve(estimate);
+    byUid.reserve(estimate);
+
+    while(data < end)
+    {
+        const char* eol = static_cast<const char*>(
+                memchr(data, '\n', end - data));
+        if(eol == NULL)
         {
-            std::istringstream stream(line);
-            std::string token;
-            std::vector<std::string> tokens;
-
-            while(std::getline(stream, token, ' '))
-            {
-                tokens.push_back(token);
-            }
-
-            // At least the x86 4.2 emulator doesn't append the seinfo
-            // field to the file, therefor I assume this is optional.
-            if(tokens.size() < 4)
-            {
-                util::logError("Read line has less than 4 tokens!");
-                packages.clear();
-                return;
-            }
-
-            // smartptrs would be great, we con't need that many copies...
-            Package package;
-            package.pkgName = tokens[0];
-            package.uid = atoi(tokens[1].c_str()); // yea, I'm lazy...
-            package.debugFlag = atoi(tokens[2].c_str()) == 1; // dito...
-            package.dataDir = tokens[3];
-
-            if(tokens.size() == 5)
-            {
-                package.seinfo = tokens[4];
-            }
-
-            packages.push_back(package);
+            eol = end;
         }
+
+        // a broken line only costs that package, parseLine tells what's
+        // wrong with it
+        if(eol != data)
+        {
+            parseLine(data, eol);
+        }
+
+        data = eol + 1;
     }
-    catch(std::exception& e)
+}
+
+bool PackageList::parseLine(const char* begin, const char* end)
+{
+    // pkgName, uid, debugFlag, dataDir and seinfo, the rest is ignored
+    StringRef tokens[5];
+    size_t count = 0;
+
+    const char* pos = begin;
+    while(count < 5 && pos <= end)
+    {
+        const char* sep = static_cast<const char*>(
+                memchr(pos, ' ', end - pos));
+        if(sep == NULL)
+        {
+            sep = end;
+        }
+
+        tokens[count++] = StringRef(pos, sep - pos);
+        pos = sep + 1;
+    }
+
+    // At least the x86 4.2 emulator doesn't append the seinfo
+    // field to the file, therefor I assume this is optional.
+    if(count < 4)
     {
-        util::logError("Failed to read packages.list: %s", e.what());
+        util::logError("Skipping package line with less than 4 tokens: %.*s",
+                static_cast<int>(end - begin), begin);
+        return false;
     }
+
+    uid_t uid = 0;
+    bool validUid = tokens[1].length > 0;
+    for(size_t i = 0; validUid && i < tokens[1].length; i++)
+    {
+        char c = tokens[1].data[i];
+        validUid = c >= '0' && c <= '9';
+        uid = uid * 10 + (c - '0');
+    }
+
+    if(!validUid)
+    {
+        util::logError("Skipping package %.*s, invalid uid: %.*s",
+                static_cast<int>(tokens[0].length), tokens[0].data,
+                static_cast<int>(tokens[1].length), tokens[1].data);
+        return false;
+    }
+
+    Package package;
+    package.pkgName = tokens[0];
+    package.uid = uid;
+    package.debugFlag = tokens[2].length == 1 && tokens[2].data[0] == '1';
+    package.dataDir = tokens[3];
+    if(count == 5)
+    {
+        package.seinfo = tokens[4];
+    }
+
+    // Shared uids show up more than once, the first one wins like it did
+    // with the linear search.
+    size_t index = packages.size();
+    packages.push_back(package);
+    byName.insert(NameIndex::value_type(package.pkgName, index));
+    byUid.insert(UidIndex::value_type(package.uid, index));
+
+    return true;
 }
 
 const Package* PackageList::findByName(const std::string& name) const
 {
-    for(Packages::const_iterator iter = packages.begin();
-            iter != packages.end(); iter++)
+    NameIndex::const_iterator iter =
+        byName.find(StringRef(name.data(), name.size()));
+    if(iter == byName.end())
     {
-        if(iter->pkgName == name)
-        {
-            return &*iter;
-        }
+        return NULL;
     }
 
-    return NULL;
+    return &packages[iter->second];
 }
 
 const Package* PackageList::findByUid(uid_t uid) const
 {
-    for(Packages::const_iterator iter = packages.begin();
-            iter != packages.end(); iter++)
+    UidIndex::const_iterator iter = byUid.find(uid);
+    if(iter == byUid.end())
     {
-        if(iter->uid == uid)
-        {
-            return &*iter;
-        }
+        return NULL;
     }
 
-    return NULL;
+    return &packages[iter->second];
+}
+
+const PackageList::Packages& PackageList::getPackages() const
+{
+    return packages;
 }
 
 GrantedPackageList::GrantedPackageList(const Package& anjaroot)
     : myself(anjaroot)
 {
-    std::string grantfile = "/data/data/" + anjaroot.pkgName + "/files/granted";
+    std::string grantfile = "/data/data/" + anjaroot.pkgName.str() +
+        "/files/granted";
     readPackages(grantfile);
 }
 
+GrantedPackageList::GrantedPackageList(const Package& anjaroot,
+        const std::string& filename) : myself(anjaroot)
+{
+    readPackages(filename);
+}
+
 void GrantedPackageList::readPackages(const std::string& filename)
 {
     try
@@ -151,7 +290,7 @@ bool GrantedPackageList::isGranted(const Package& package) const
     for(Packages::const_iterator iter = packages.begin();
             iter != packages.end(); iter++)
     {
-        if(*iter == package.pkgName)
+        if(package.pkgName == *iter)
         {
             return true;
         }
@@ -160,4 +299,9 @@ bool GrantedPackageList::isGranted(const Package& package) const
     return false;
 }
 
+const GrantedPackageList::Packages& GrantedPackageList::getPackages() const
+{
+    return packages;
+}
+
 }
@@ -22,10 +22,31 @@
 
 #include <string>
 #include <vector>
+#include <unordered_map>
 #include <unistd.h>
 
 namespace packages
 {
+    // Points into memory owned by someone else (the mapped packages.list),
+    // there is no string_view in our toolchain.
+    struct StringRef
+    {
+        StringRef();
+        StringRef(const char* data_, size_t length_);
+
+        bool operator==(const StringRef& other) const;
+        bool operator==(const std::string& other) const;
+        std::string str() const;
+
+        const char* data;
+        size_t length;
+    };
+
+    struct StringRefHash
+    {
+        size_t operator()(const StringRef& ref) const;
+    };
+
     /* Format is described in the run-as source which can be found in the
      * platform_system_core repository.
      *
@@ -43,32 +64,54 @@ namespace packages
      *  <seinfo>     is the seinfo label associated with the package
      *
      * The file is generated in com.android.server.PackageManagerService.Settings.writeLP()
+     *
+     * Newer versions append more fields (gids, profileable flags, ...), we
+     * just ignore anything after seinfo.
+     *
+     * The strings reference the mapping of the PackageList they came from,
+     * so a Package is only valid as long as that list is alive.
      */
     struct Package
     {
         Package();
 
-        std::string pkgName;
+        StringRef pkgName;
         uid_t uid;
         bool debugFlag;
-        std::string dataDir;
-        std::string seinfo;
+        StringRef dataDir;
+        StringRef seinfo;
     };
 
+    // Maps packages.list and tokenises it in place, the name and uid indexes
+    // are filled in the same pass.
     class PackageList
     {
         public:
             typedef std::vector<Package> Packages;
 
             PackageList();
+            ~PackageList();
 
             const Package* findByName(const std::string& name) const;
             const Package* findByUid(uid_t uid) const;
+            const Packages& getPackages() const;
 
         private:
+            typedef std::unordered_map<StringRef, size_t, StringRefHash>
+                NameIndex;
+            typedef std::unordered_map<uid_t, size_t> UidIndex;
+
+            PackageList(const PackageList&);
+            PackageList& operator=(const PackageList&);
+
             void readPackages();
+            bool parseLine(const char* begin, const char* end);
 
+            void* mapping;
+            size_t mappingSize;
             Packages packages;
+            NameIndex byName;
+            UidIndex byUid;
     };
 
     class GrantedPackageList
@@ -77,8 +120,11 @@ namespace packages
             typedef std::vector<std::string> Packages;
 
             GrantedPackageList(const Package& anjaroot);
+            GrantedPackageList(const Package& anjaroot,
+                    const std::string& filename);
 
             bool isGranted(const Package& package) const;
+            const Packages& getPackages() const;
 
         private:
             void readPackages(const std::string& filename);
@@ -0,0 +1,347 @@
+/*
+ * Copyright 2013 Simon Brakhane
+ *
+ * This file is part of AnJaRoot.
+ *
+ * AnJaRoot is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * AnJaRoot is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * AnJaRoot. If not, see http://www.gnu.org/licenses/.
+ */
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+#include "policy.h"
+#include "stats.h"
+#include "shared/util.h"
+
+static stats::Counter cacheHits("policy cache hits");
+static stats::Counter cacheMisses("policy cache misses");
+static stats::Counter cacheReloads("policy reloads");
+static stats::Counter prefetchMisses("policy prefetch misses");
+
+namespace
+{
+    class ScopedLock
+    {
+        public:
+            ScopedLock(pthread_mutex_t& mutex_) : mutex(mutex_)
+            {
+                pthread_mutex_lock(&mutex);
+            }
+
+            ~ScopedLock()
+            {
+                pthread_mutex_unlock(&mutex);
+            }
+
+        private:
+            pthread_mutex_t& mutex;
+    };
+}
+
+static const uint32_t WatchMask = IN_CLOSE_WRITE | IN_MOVED_TO |
+    IN_MOVED_FROM | IN_CREATE | IN_DELETE | IN_DELETE_SELF | IN_MOVE_SELF;
+
+const char* policy::GrantCache::SnapshotPath = "/data/misc/anjaroot/policy";
+
+policy::GrantCache::GrantCache() : fd(-1), valid(false), generation(0),
+    prefetching(false)
+{
+    pthread_mutex_init(&stateLock, NULL);
+    pthread_mutex_init(&reloadLock, NULL);
+
+    // inotify_init1 isn't available in older bionic versions
+    fd = inotify_init();
+    if(fd == -1)
+    {
+        // Not fatal, the snapshot just never counts as current then
+        util::logError("Failed to init inotify, grant cache disabled: %s",
+                strerror(errno));
+        return;
+    }
+
+    int flags = fcntl(fd, F_GETFL);
+    if(flags == -1 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) == -1 ||
+            fcntl(fd, F_SETFD, FD_CLOEXEC) == -1)
+    {
+        util::logError("Failed to setup inotify fd, grant cache disabled: %s",
+                strerror(errno));
+        close(fd);
+        fd = -1;
+    }
+}
+
+policy::GrantCache::~GrantCache()
+{
+    if(fd != -1)
+    {
+        close(fd);
+    }
+
+    pthread_mutex_destroy(&stateLock);
+    pthread_mutex_destroy(&reloadLock);
+}
+
+int policy::GrantCache::getFd() const
+{
+    return fd;
+}
+
+void policy::GrantCache::setPrefetching(bool value)
+{
+    prefetching = value;
+}
+
+void policy::GrantCache::invalidate()
+{
+    valid = false;
+    generation++;
+}
+
+bool policy::GrantCache::updateWatches(const std::vector<int>& users)
+{
+    if(fd == -1)
+    {
+        return false;
+    }
+
+    Watches wanted;
+    Watch packages = {-1, "/data/system", "packages.list"};
+    wanted.push_back(packages);
+    // new users have to be picked up too
+    Watch userdir = {-1, "/data/user", ""};
+    wanted.push_back(userdir);
+    for(std::vector<int>::const_iterator user = users.begin();
+            user != users.end(); user++)
+    {
+        Watch granted = {-1, getGrantedDir(*user), "granted"};
+        wanted.push_back(granted);
+    }
+
+    // The files dir doesn't exist before the granter app wrote anything (or
+    // even got installed), so we walk up till we find something to watch.
+    // Once the missing dir shows up there the snapshot goes stale and the
+    // next rebuild moves the watch further down.
+    bool complete = true;
+    for(Watches::iterator w = wanted.begin(); w != wanted.end(); w++)
+    {
+        w->wd = inotify_add_watch(fd, w->path.c_str(), WatchMask);
+        while(w->wd == -1 && errno == ENOENT && !w->name.empty())
+        {
+            std::string::size_type slash = w->path.rfind('/');
+            if(slash == 0 || slash == std::string::npos)
+            {
+                break;
+            }
+
+            w->name = w->path.substr(slash + 1);
+            w->path.erase(slash);
+            w->wd = inotify_add_watch(fd, w->path.c_str(), WatchMask);
+        }
+
+        if(w->wd == -1 && !w->name.empty())
+        {
+            LOGV(Policy, "Failed to watch %s: %s", w->path.c_str(),
+                    strerror(errno));
+            complete = false;
+        }
+    }
+
+    // Adding a watch for an already watched path just hands out the same
+    // descriptor again, so only the ones nobody wants anymore need care.
+    for(Watches::const_iterator old = watches.begin(); old != watches.end();
+            old++)
+    {
+        bool keep = false;
+        for(Watches::const_iterator w = wanted.begin(); w != wanted.end(); w++)
+        {
+            keep = keep || w->wd == old->wd;
+        }
+
+        if(!keep && old->wd != -1)
+        {
+            inotify_rm_watch(fd, old->wd);
+        }
+    }
+
+    watches.swap(wanted);
+    return complete;
+}
+
+void policy::GrantCache::refresh()
+{
+    // only one rebuild at a time, a second caller waits for it and most
+    // likely finds a valid snapshot afterwards
+    ScopedLock reloading(reloadLock);
+
+    std::vector<int> users;
+    unsigned long startGeneration = 0;
+    bool watched = false;
+    {
+        ScopedLock locked(stateLock);
+        if(valid)
+        {
+            return;
+        }
+
+        // Watches have to be in place before reading, otherwise we could
+        // miss a change happening right in between.
+        users = getUsers();
+        watched = updateWatches(users);
+        startGeneration = generation;
+    }
+
+    cacheReloads.add();
+
+    std::shared_ptr<Snapshot> fresh(new Snapshot());
+    SnapshotImage image = buildSnapshot(users);
+    if(!writeSnapshot(SnapshotPath, image) || !fresh->load(SnapshotPath))
+    {
+        util::logError("Using in memory policy snapshot");
+        fresh->adopt(image);
+    }
+
+    ScopedLock locked(stateLock);
+    current = fresh;
+    // anything changing while we were busy means another round, events not
+    // processed yet invalidate it once the reactor gets to them
+    valid = watched && generation == startGeneration;
+}
+
+void policy::GrantCache::handleEvent(const struct inotify_event* ev)
+{
+    if(ev->mask & IN_Q_OVERFLOW)
+    {
+        invalidate();
+        return;
+    }
+
+    for(Watches::iterator w = watches.begin(); w != watches.end(); w++)
+    {
+        if(w->wd != ev->wd)
+        {
+            continue;
+        }
+
+        // The watched directory itself is gone, the kernel drops the watch
+        // and it gets added again on the next reload
+        if(ev->mask & (IN_IGNORED | IN_DELETE_SELF | IN_MOVE_SELF))
+        {
+            w->wd = -1;
+            invalidate();
+        }
+        else if(w->name.empty() || (ev->len > 0 && w->name == ev->name))
+        {
+            LOGV(Policy, "%s changed, policy is stale", w->path.c_str());
+            invalidate();
+        }
+    }
+}
+
+void policy::GrantCache::processEvents()
+{
+    ScopedLock locked(stateLock);
+    drainEvents();
+}
+
+void policy::GrantCache::drainEvents()
+{
+    if(fd == -1)
+    {
+        return;
+    }
+
+    char buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    while(true)
+    {
+        ssize_t len = read(fd, buf, sizeof(buf));
+        if(len == -1)
+        {
+            if(errno == EINTR)
+            {
+                continue;
+            }
+
+            if(errno != EAGAIN)
+            {
+                util::logError("Failed to read inotify events: %s",
+                        strerror(errno));
+                invalidate();
+            }
+            return;
+        }
+
+        for(char* ptr = buf; ptr < buf + len;)
+        {
+            const struct inotify_event* ev =
+                reinterpret_cast<const struct inotify_event*>(ptr);
+            ptr += sizeof(struct inotify_event) + ev->len;
+
+            handleEvent(ev);
+        }
+    }
+}
+
+std::shared_ptr<policy::Snapshot> policy::GrantCache::acquire()
+{
+    std::shared_ptr<Snapshot> snapshot;
+    {
+        // Just a pointer copy, the inotify fd is only read by the reactor
+        // through processEvents
+        ScopedLock locked(stateLock);
+        if(valid)
+        {
+            snapshot = current;
+        }
+    }
+
+    if(snapshot)
+    {
+        cacheHits.add();
+        return snapshot;
+    }
+
+    cacheMisses.add();
+    if(prefetching)
+    {
+        prefetchMisses.add();
+    }
+
+    // A stale snapshot may still grant a revoked uid, so it's never handed
+    // out. refresh() waits for a rebuild the prefetch thread already has in
+    // flight, and only builds one itself if there is none.
+    refresh();
+
+    ScopedLock locked(stateLock);
+    return current;
+}
+
+bool policy::GrantCache::isUidGranted(uid_t uid)
+{
+    std::shared_ptr<Snapshot> snapshot = acquire();
+    return snapshot && snapshot->isGranted(uid);
+}
+
+bool policy::GrantCache::hasGrants()
+{
+    std::shared_ptr<Snapshot> snapshot = acquire();
+    return snapshot && !snapshot->isEmpty();
+}
+
+policy::GrantCache& policy::getGrantCache()
+{
+    static GrantCache cache;
+    return cache;
+}
@@ -0,0 +1,106 @@
+/*
+ * Copyright 2013 Simon Brakhane
+ *
+ * This file is part of AnJaRoot.
+ *
+ * AnJaRoot is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * AnJaRoot is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * AnJaRoot. If not, see http://www.gnu.org/licenses/.
+ */
+
+#ifndef _ANJAROOTD_POLICY_H_
+#define _ANJAROOTD_POLICY_H_
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+#include <pthread.h>
+#include <sys/inotify.h>
+#include <sys/types.h>
+
+#include "policysnapshot.h"
+
+namespace policy
+{
+    // Keeps the compiled policy snapshot mapped, so a capset stop is a single
+    // bit test and never touches packages.list or the granted files. All the
+    // inputs are watched with inotify, any change to them marks the snapshot
+    // stale and the Prefetcher rebuilds it. A lookup never uses a stale
+    // snapshot, it waits for the rebuild in flight or does it on its own.
+    //
+    // The watches are on the containing directories, the granter app replaces
+    // its granted file with a rename and the package manager does the same for
+    // packages.list. A directory which doesn't exist yet is watched through
+    // its nearest existing parent.
+    //
+    // Lookups come from the tracer thread, refreshes also from the prefetch
+    // thread. The state lock is only held for short bookkeeping, never while
+    // a snapshot is built.
+    class GrantCache
+    {
+        public:
+            static const char* SnapshotPath;
+
+            GrantCache();
+            ~GrantCache();
+
+            bool isUidGranted(uid_t uid);
+            bool hasGrants();
+
+            // Rebuilds the snapshot if any of its inputs changed, does
+            // nothing otherwise.
+            void refresh();
+
+            // Reads all pending inotify events without blocking, the only
+            // place changes are picked up
+            void processEvents();
+            int getFd() const;
+
+            void setPrefetching(bool value);
+
+        private:
+            struct Watch
+            {
+                int wd;
+                std::string path;
+                // only events for this name matter, empty means any
+                std::string name;
+            };
+            typedef std::vector<Watch> Watches;
+
+            GrantCache(const GrantCache&);
+            GrantCache& operator=(const GrantCache&);
+
+            // a current snapshot, rebuilt first if it's stale
+            std::shared_ptr<Snapshot> acquire();
+
+            // all of these need stateLock held
+            void drainEvents();
+            bool updateWatches(const std::vector<int>& users);
+            void handleEvent(const struct inotify_event* ev);
+            void invalidate();
+
+            int fd;
+            pthread_mutex_t stateLock;
+            pthread_mutex_t reloadLock;
+            bool valid;
+            unsigned long generation;
+            Watches watches;
+            std::shared_ptr<Snapshot> current;
+            std::atomic<bool> prefetching;
+    };
+
+    GrantCache& getGrantCache();
+}
+
+#endif
@@ -0,0 +1,353 @@
+/*
+ * Copyright 2013 Simon Brakhane
+ *
+ * This file is part of AnJaRoot.
+ *
+ * AnJaRoot is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * AnJaRoot is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * AnJaRoot. If not, see http://www.gnu.org/licenses/.
+ */
+#include <map>
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "policysnapshot.h"
+#include "hook.h"
+#include "packages.h"
+#include "shared/util.h"
+
+policy::Snapshot::Snapshot() : mapping(NULL), mappingSize(0), header(NULL),
+    users(NULL)
+{
+}
+
+policy::Snapshot::~Snapshot()
+{
+    release();
+}
+
+void policy::Snapshot::release()
+{
+    if(mapping != NULL)
+    {
+        munmap(mapping, mappingSize);
+        mapping = NULL;
+        mappingSize = 0;
+    }
+
+    image.clear();
+    header = NULL;
+    users = NULL;
+}
+
+bool policy::Snapshot::validate(const void* data, size_t size) const
+{
+    if(size < sizeof(SnapshotHeader))
+    {
+        return false;
+    }
+
+    const SnapshotHeader* hdr = static_cast<const SnapshotHeader*>(data);
+    return hdr->magic == SnapshotHeader::Magic &&
+        hdr->version == SnapshotHeader::Version &&
+        size == sizeof(SnapshotHeader) + hdr->count * sizeof(uint32_t);
+}
+
+bool policy::Snapshot::load(const std::string& path)
+{
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if(fd == -1)
+    {
+        util::logError("Failed to open %s: %s", path.c_str(), strerror(errno));
+        return false;
+    }
+
+    struct stat st;
+    if(fstat(fd, &st) == -1)
+    {
+        util::logError("Failed to stat %s: %s", path.c_str(), strerror(errno));
+        close(fd);
+        return false;
+    }
+
+    void* addr = MAP_FAILED;
+    if(st.st_size > 0)
+    {
+        addr = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    }
+    close(fd);
+
+    if(addr == MAP_FAILED)
+    {
+        util::logError("Failed to map %s: %s", path.c_str(), strerror(errno));
+        return false;
+    }
+
+    if(!validate(addr, st.st_size))
+    {
+        util::logError("%s is not a valid policy snapshot", path.c_str());
+        munmap(addr, st.st_size);
+        return false;
+    }
+
+    release();
+    mapping = addr;
+    mappingSize = st.st_size;
+    header = static_cast<const SnapshotHeader*>(mapping);
+    users = reinterpret_cast<const uint32_t*>(header + 1);
+
+    return true;
+}
+
+void policy::Snapshot::adopt(const SnapshotImage& image_)
+{
+    release();
+
+    if(!validate(&image_[0], image_.size() * sizeof(uint32_t)))
+    {
+        util::logError("Refusing to adopt invalid policy snapshot");
+        return;
+    }
+
+    image = image_;
+    header = reinterpret_cast<const SnapshotHeader*>(&image[0]);
+    users = reinterpret_cast<const uint32_t*>(header + 1);
+}
+
+bool policy::Snapshot::isGranted(uid_t uid) const
+{
+    if(header == NULL)
+    {
+        return false;
+    }
+
+    uid_t user = uid / PerUserRange;
+    uid_t appId = uid % PerUserRange;
+    if(user >= static_cast<uid_t>(MaxUsers))
+    {
+        return false;
+    }
+
+    if(header->granterAppId != 0 && appId == header->granterAppId)
+    {
+        return true;
+    }
+
+    if(appId < header->firstAppId ||
+            appId - header->firstAppId >= header->count)
+    {
+        return false;
+    }
+
+    return (users[appId - header->firstAppId] >> user) & 1;
+}
+
+bool policy::Snapshot::isEmpty() const
+{
+    // only appIds with at least one bit set span the stored range, the
+    // granter isn't part of it
+    return header == NULL || header->count == 0;
+}
+
+std::vector<int> policy::getUsers()
+{
+    // The primary user always exists, the others show up in /data/user. The
+    // 0 entry in there is only a symlink to /data/data.
+    std::vector<int> result;
+    result.push_back(0);
+
+    DIR* dir = opendir("/data/user");
+    if(dir == NULL)
+    {
+        return result;
+    }
+
+    struct dirent* entry;
+    while((entry = readdir(dir)) != NULL)
+    {
+        char* end;
+        long user = strtol(entry->d_name, &end, 10);
+        if(end == entry->d_name || *end != '\0' || user <= 0)
+        {
+            continue;
+        }
+
+        if(user >= MaxUsers)
+        {
+            util::logError("Ignoring user %ld, too many users", user);
+            continue;
+        }
+
+        result.push_back(user);
+    }
+    closedir(dir);
+
+    return result;
+}
+
+std::string policy::getGrantedDir(int user)
+{
+    if(user == 0)
+    {
+        return std::string("/data/data/") + hook::GranterPackageName +
+            "/files";
+    }
+
+    char prefix[32];
+    snprintf(prefix, sizeof(prefix), "/data/user/%d/", user);
+    return prefix + std::string(hook::GranterPackageName) + "/files";
+}
+
+policy::SnapshotImage policy::buildSnapshot(const std::vector<int>& userIds)
+{
+    typedef std::map<uid_t, uint32_t> Bits;
+    Bits bits;
+    uid_t granter = 0;
+
+    packages::PackageList pkgs;
+    const packages::Package* anjaroot =
+        pkgs.findByName(hook::GranterPackageName);
+    if(anjaroot == NULL)
+    {
+        util::logError("Couldn't get anjaroot package");
+    }
+    else
+    {
+        // The granter is always allowed to use itself, for every user. That's
+        // stored in the header so an otherwise empty policy stays empty.
+        granter = anjaroot->uid % PerUserRange;
+
+        for(std::vector<int>::const_iterator user = userIds.begin();
+                user != userIds.end(); user++)
+        {
+            packages::GrantedPackageList granted(*anjaroot,
+                    getGrantedDir(*user) + "/granted");
+            const packages::GrantedPackageList::Packages& names =
+                granted.getPackages();
+
+            for(packages::GrantedPackageList::Packages::const_iterator name =
+                    names.begin(); name != names.end(); name++)
+            {
+                const packages::Package* pkg = pkgs.findByName(*name);
+                if(pkg == NULL)
+                {
+                    LOGV(Policy, "Granted package %s isn't installed",
+                            name->c_str());
+                    continue;
+                }
+
+                uid_t appId = pkg->uid % PerUserRange;
+                if(appId != granter)
+                {
+                    bits[appId] |= 1U << *user;
+                }
+            }
+        }
+    }
+
+    // Only the range between the lowest and highest granted appId is
+    // stored, usually that's just a few words.
+    uid_t first = bits.empty() ? 0 : bits.begin()->first;
+    uid_t count = bits.empty() ? 0 : bits.rbegin()->first - first + 1;
+
+    SnapshotImage image(sizeof(SnapshotHeader) / sizeof(uint32_t) + count, 0);
+    SnapshotHeader* hdr = reinterpret_cast<SnapshotHeader*>(&image[0]);
+    hdr->magic = SnapshotHeader::Magic;
+    hdr->version = SnapshotHeader::Version;
+    hdr->granterAppId = granter;
+    hdr->firstAppId = first;
+    hdr->count = count;
+
+    uint32_t* words = reinterpret_cast<uint32_t*>(hdr + 1);
+    for(Bits::const_iterator iter = bits.begin(); iter != bits.end(); iter++)
+    {
+        words[iter->first - first] = iter->second;
+    }
+
+    return image;
+}
+
+bool policy::writeSnapshot(const std::string& path, const SnapshotImage& image)
+{
+    std::string dir = path.substr(0, path.rfind('/'));
+    if(mkdir(dir.c_str(), 0700) == -1 && errno != EEXIST)
+    {
+        util::logError("Failed to create %s: %s", dir.c_str(),
+                strerror(errno));
+        return false;
+    }
+
+    // Readers map whatever the name points to, so the new version is written
+    // completely aside and then renamed over the old one.
+    std::string tmp = path + ".tmp";
+    int fd = open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    if(fd == -1)
+    {
+        util::logError("Failed to create %s: %s", tmp.c_str(),
+                strerror(errno));
+        return false;
+    }
+
+    const char* data = reinterpret_cast<const char*>(&image[0]);
+    size_t left = image.size() * sizeof(uint32_t);
+    while(left > 0)
+    {
+        ssize_t ret = write(fd, data, left);
+        if(ret == -1)
+        {
+            if(errno == EINTR)
+            {
+                continue;
+            }
+
+            util::logError("Failed to write %s: %s", tmp.c_str(),
+                    strerror(errno));
+            close(fd);
+            unlink(tmp.c_str());
+            return false;
+        }
+
+        data += ret;
+        left -= ret;
+    }
+
+    int ret = fsync(fd);
+    if(ret == -1)
+    {
+        util::logError("Failed to sync %s: %s", tmp.c_str(), strerror(errno));
+    }
+    close(fd);
+
+    if(ret == -1)
+    {
+        unlink(tmp.c_str());
+        return false;
+    }
+
+    if(rename(tmp.c_str(), path.c_str()) == -1)
+    {
+        util::logError("Failed to rename %s: %s", tmp.c_str(),
+                strerror(errno));
+        unlink(tmp.c_str());
+        return false;
+    }
+
+    return true;
+}
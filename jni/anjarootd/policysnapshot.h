@@ -0,0 +1,89 @@
+/*
+ * Copyright 2013 Simon Brakhane
+ *
+ * This file is part of AnJaRoot.
+ *
+ * AnJaRoot is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * AnJaRoot is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * AnJaRoot. If not, see http://www.gnu.org/licenses/.
+ */
+
+#ifndef _ANJAROOTD_POLICYSNAPSHOT_H_
+#define _ANJAROOTD_POLICYSNAPSHOT_H_
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include <sys/types.h>
+
+namespace policy
+{
+    // Android uids are userId * PerUserRange + appId
+    static const uid_t PerUserRange = 100000;
+    static const int MaxUsers = 32;
+
+    // On disk layout of the compiled policy, everything is native endian as
+    // the file never leaves the device. The header is followed by count
+    // words, word n holds the bitset of users the appId firstAppId + n is
+    // granted for. The granter itself is kept out of the words, it is always
+    // allowed for every user and would otherwise make every snapshot look
+    // like somebody is granted. 0 means it isn't installed.
+    struct SnapshotHeader
+    {
+        static const uint32_t Magic = 0x504a5241; // "ARJP" in memory
+        static const uint32_t Version = 2;
+
+        uint32_t magic;
+        uint32_t version;
+        uint32_t granterAppId;
+        uint32_t firstAppId;
+        uint32_t count;
+    };
+
+    typedef std::vector<uint32_t> SnapshotImage;
+
+    class Snapshot
+    {
+        public:
+            Snapshot();
+            ~Snapshot();
+
+            bool load(const std::string& path);
+            void adopt(const SnapshotImage& image_);
+            bool isGranted(uid_t uid) const;
+            // true if no package besides the granter is granted
+            bool isEmpty() const;
+
+        private:
+            Snapshot(const Snapshot&);
+            Snapshot& operator=(const Snapshot&);
+
+            bool validate(const void* data, size_t size) const;
+            void release();
+
+            void* mapping;
+            size_t mappingSize;
+            SnapshotImage image;
+            const SnapshotHeader* header;
+            const uint32_t* users;
+    };
+
+    std::vector<int> getUsers();
+    std::string getGrantedDir(int user);
+
+    // Reads packages.list and the granted file of every user, this is the
+    // only place which still parses text.
+    SnapshotImage buildSnapshot(const std::vector<int>& userIds);
+    bool writeSnapshot(const std::string& path, const SnapshotImage& image);
+}
+
+#endif
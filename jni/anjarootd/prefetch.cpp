@@ -0,0 +1,143 @@
+/*
+ * Copyright 2013 Simon Brakhane
+ *
+ * This file is part of AnJaRoot.
+ *
+ * AnJaRoot is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * AnJaRoot is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * AnJaRoot. If not, see http://www.gnu.org/licenses/.
+ */
+#include <errno.h>
+#include <string.h>
+
+#include "prefetch.h"
+#include "policy.h"
+#include "shared/util.h"
+
+policy::Prefetcher::Prefetcher() : running(false), shouldStop(false)
+{
+    // statics die in reverse order, the cache has to outlive us
+    getGrantCache();
+    sem_init(&pending, 0, 0);
+}
+
+policy::Prefetcher::~Prefetcher()
+{
+    stop();
+    sem_destroy(&pending);
+}
+
+bool policy::Prefetcher::start()
+{
+    if(running)
+    {
+        return true;
+    }
+
+    shouldStop = false;
+    int ret = pthread_create(&thread, NULL, Prefetcher::threadMain, this);
+    if(ret != 0)
+    {
+        // not fatal, lookups just refresh the cache on their own
+        util::logError("Failed to start prefetch thread: %s", strerror(ret));
+        return false;
+    }
+
+    running = true;
+    getGrantCache().setPrefetching(true);
+
+    // the first snapshot gets built here too, not in the first capset stop
+    sem_post(&pending);
+    return true;
+}
+
+void policy::Prefetcher::stop()
+{
+    if(!running)
+    {
+        return;
+    }
+
+    shouldStop = true;
+    sem_post(&pending);
+    pthread_join(thread, NULL);
+
+    running = false;
+    getGrantCache().setPrefetching(false);
+}
+
+void policy::Prefetcher::notifyFork()
+{
+    if(running)
+    {
+        sem_post(&pending);
+    }
+}
+
+void policy::Prefetcher::notifyPolicyChange()
+{
+    // same as a fork, the refresh happens on every wakeup anyway
+    notifyFork();
+}
+
+void* policy::Prefetcher::threadMain(void* arg)
+{
+    static_cast<Prefetcher*>(arg)->run();
+    return NULL;
+}
+
+void policy::Prefetcher::run()
+{
+    LOGV(Policy, "Prefetch thread started");
+
+    while(true)
+    {
+        if(sem_wait(&pending) == -1)
+        {
+            if(errno == EINTR)
+            {
+                continue;
+            }
+
+            util::logError("Prefetch thread failed to wait: %s",
+                    strerror(errno));
+            break;
+        }
+
+        if(shouldStop)
+        {
+            break;
+        }
+
+        // A launch storm only needs one refresh, so eat the other wakeups
+        while(sem_trywait(&pending) == 0)
+        {
+        }
+
+        try
+        {
+            getGrantCache().refresh();
+        }
+        catch(std::exception& e)
+        {
+            util::logError("Prefetch failed: %s", e.what());
+        }
+    }
+
+    LOGV(Policy, "Prefetch thread stopped");
+}
+
+policy::Prefetcher& policy::getPrefetcher()
+{
+    static Prefetcher prefetcher;
+    return prefetcher;
+}
@@ -0,0 +1,62 @@
+/*
+ * Copyright 2013 Simon Brakhane
+ *
+ * This file is part of AnJaRoot.
+ *
+ * AnJaRoot is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * AnJaRoot is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * AnJaRoot. If not, see http://www.gnu.org/licenses/.
+ */
+
+#ifndef _ANJAROOTD_PREFETCH_H_
+#define _ANJAROOTD_PREFETCH_H_
+
+#include <atomic>
+#include <pthread.h>
+#include <semaphore.h>
+
+namespace policy
+{
+    // Worker thread refreshing the GrantCache while a new zygote child is
+    // still on its way to capset, so the tracer only has to do the lookup.
+    // The worker only gets woken up, it never touches a tracee, ptrace
+    // requests have to come from the thread which attached.
+    class Prefetcher
+    {
+        public:
+            Prefetcher();
+            ~Prefetcher();
+
+            bool start();
+            void stop();
+
+            // tracer side, never blocks
+            void notifyFork();
+            void notifyPolicyChange();
+
+        private:
+            Prefetcher(const Prefetcher&);
+            Prefetcher& operator=(const Prefetcher&);
+
+            static void* threadMain(void* arg);
+            void run();
+
+            sem_t pending;
+            pthread_t thread;
+            bool running;
+            std::atomic<bool> shouldStop;
+    };
+
+    Prefetcher& getPrefetcher();
+}
+
+#endif
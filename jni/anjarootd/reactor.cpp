@@ -0,0 +1,321 @@
+/*
+ * Copyright 2013 Simon Brakhane
+ *
+ * This file is part of AnJaRoot.
+ *
+ * AnJaRoot is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * AnJaRoot is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * AnJaRoot. If not, see http://www.gnu.org/licenses/.
+ */
+#include <algorithm>
+#include <system_error>
+
+#include <asm/unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <time.h>
+
+#include "reactor.h"
+#include "shared/util.h"
+
+// Old NDK headers lack most of these, the numbers are stable per arch
+#if defined(__arm__)
+#   ifndef __NR_timerfd_create
+#   define __NR_timerfd_create 350
+#   endif
+#   ifndef __NR_timerfd_settime
+#   define __NR_timerfd_settime 353
+#   endif
+#   ifndef __NR_signalfd4
+#   define __NR_signalfd4 355
+#   endif
+#   ifndef __NR_pidfd_open
+#   define __NR_pidfd_open 434
+#   endif
+#elif defined(__i386__)
+#   ifndef __NR_timerfd_create
+#   define __NR_timerfd_create 322
+#   endif
+#   ifndef __NR_timerfd_settime
+#   define __NR_timerfd_settime 325
+#   endif
+#   ifndef __NR_signalfd4
+#   define __NR_signalfd4 327
+#   endif
+#   ifndef __NR_pidfd_open
+#   define __NR_pidfd_open 434
+#   endif
+#elif defined(__mips__)
+#   ifndef __NR_timerfd_create
+#   define __NR_timerfd_create 4321
+#   endif
+#   ifndef __NR_timerfd_settime
+#   define __NR_timerfd_settime 4323
+#   endif
+#   ifndef __NR_signalfd4
+#   define __NR_signalfd4 4324
+#   endif
+#   ifndef __NR_pidfd_open
+#   define __NR_pidfd_open 4434
+#   endif
+#endif
+
+#ifndef CLOCK_MONOTONIC
+#define CLOCK_MONOTONIC 1
+#endif
+
+// The kernel's sigset, not bionic's: that one is only 32bit wide on 32bit
+// targets (and MIPS has 128 signals).
+#if defined(__mips__)
+static const std::size_t KernelSigsetWords = 4;
+#else
+static const std::size_t KernelSigsetWords = 2;
+#endif
+
+// struct signalfd_siginfo, we only need the signal number out of it
+struct SignalFdInfo
+{
+    uint32_t signo;
+    uint8_t pad[124];
+};
+
+reactor::Reactor::Reactor() : epfd(-1)
+{
+    // epoll_create1 isn't available in older bionic versions
+    epfd = epoll_create(8);
+    if(epfd == -1)
+    {
+        util::logError("Failed to create epoll fd: %s", strerror(errno));
+        throw std::system_error(errno, std::system_category());
+    }
+
+    fcntl(epfd, F_SETFD, FD_CLOEXEC);
+}
+
+reactor::Reactor::~Reactor()
+{
+    for(Entries::const_iterator iter = entries.begin();
+            iter != entries.end(); iter++)
+    {
+        if(iter->second.owned)
+        {
+            close(iter->first);
+        }
+    }
+
+    close(epfd);
+}
+
+void reactor::Reactor::add(int fd, uint32_t events, const Callback& callback,
+        bool owned)
+{
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = events;
+    ev.data.fd = fd;
+
+    int ret = epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev);
+    if(ret == -1)
+    {
+        int err = errno;
+        util::logError("Failed to add fd %d to epoll: %s", fd, strerror(err));
+        if(owned)
+        {
+            close(fd);
+        }
+        throw std::system_error(err, std::system_category());
+    }
+
+    Entry entry = {callback, owned};
+    entries[fd] = entry;
+}
+
+void reactor::Reactor::remove(int fd)
+{
+    Entries::iterator iter = entries.find(fd);
+    if(iter == entries.end())
+    {
+        return;
+    }
+
+    epoll_ctl(epfd, EPOLL_CTL_DEL, fd, NULL);
+    if(iter->second.owned)
+    {
+        close(fd);
+    }
+    entries.erase(iter);
+}
+
+int reactor::Reactor::poll(int timeout)
+{
+    struct epoll_event events[16];
+    int count = epoll_wait(epfd, events, sizeof(events) / sizeof(events[0]),
+            timeout);
+    if(count == -1)
+    {
+        if(errno == EINTR)
+        {
+            return 0;
+        }
+
+        util::logError("Failed to wait for events: %s", strerror(errno));
+        throw std::system_error(errno, std::system_category());
+    }
+
+    for(int i = 0; i < count; i++)
+    {
+        // an earlier callback may have removed this one already
+        Entries::const_iterator iter = entries.find(events[i].data.fd);
+        if(iter != entries.end())
+        {
+            // the callback may remove itself, don't touch iter afterwards
+            Callback callback = iter->second.callback;
+            callback(events[i].events);
+        }
+    }
+
+    return count;
+}
+
+int reactor::openSignalFd(const int* signals, std::size_t count)
+{
+    uint32_t mask[KernelSigsetWords];
+    memset(mask, 0, sizeof(mask));
+    for(std::size_t i = 0; i < count; i++)
+    {
+        mask[(signals[i] - 1) / 32] |= 1U << ((signals[i] - 1) % 32);
+    }
+
+    return syscall(__NR_signalfd4, -1, mask, sizeof(mask),
+            O_NONBLOCK | O_CLOEXEC);
+}
+
+int reactor::readSignalFd(int fd)
+{
+    SignalFdInfo info;
+    ssize_t ret;
+    do
+    {
+        ret = read(fd, &info, sizeof(info));
+    } while(ret == -1 && errno == EINTR);
+
+    if(ret == -1)
+    {
+        return errno == EAGAIN ? 0 : -1;
+    }
+
+    return ret == sizeof(info) ? info.signo : -1;
+}
+
+int reactor::openTimerFd()
+{
+    return syscall(__NR_timerfd_create, CLOCK_MONOTONIC,
+            O_NONBLOCK | O_CLOEXEC);
+}
+
+bool reactor::setTimerFd(int fd, int valueMs, int intervalMs)
+{
+    struct itimerspec spec;
+    memset(&spec, 0, sizeof(spec));
+    spec.it_value.tv_sec = valueMs / 1000;
+    spec.it_value.tv_nsec = (valueMs % 1000) * 1000000L;
+    spec.it_interval.tv_sec = intervalMs / 1000;
+    spec.it_interval.tv_nsec = (intervalMs % 1000) * 1000000L;
+
+    return syscall(__NR_timerfd_settime, fd, 0, &spec, NULL) == 0;
+}
+
+uint64_t reactor::readTimerFd(int fd)
+{
+    uint64_t expirations = 0;
+    if(read(fd, &expirations, sizeof(expirations)) != sizeof(expirations))
+    {
+        return 0;
+    }
+
+    return expirations;
+}
+
+int reactor::openPidFd(pid_t pid)
+{
+    // Linux 5.3+, the fd becomes readable once the process exited
+    int fd = syscall(__NR_pidfd_open, pid, 0);
+    if(fd != -1)
+    {
+        fcntl(fd, F_SETFD, FD_CLOEXEC);
+    }
+
+    return fd;
+}
+
+reactor::RetryTimer::RetryTimer(int initialMs_, int maxMs_) : fd(-1),
+    initialMs(initialMs_), maxMs(maxMs_), delayMs(initialMs_), pending(false)
+{
+    fd = openTimerFd();
+    if(fd == -1)
+    {
+        util::logError("Failed to create retry timer: %s", strerror(errno));
+        throw std::system_error(errno, std::system_category());
+    }
+}
+
+reactor::RetryTimer::~RetryTimer()
+{
+    close(fd);
+}
+
+int reactor::RetryTimer::getFd() const
+{
+    return fd;
+}
+
+void reactor::RetryTimer::schedule()
+{
+    if(pending)
+    {
+        return;
+    }
+
+    if(!setTimerFd(fd, delayMs, 0))
+    {
+        util::logError("Failed to arm retry timer: %s", strerror(errno));
+        return;
+    }
+
+    pending = true;
+    delayMs = std::min(delayMs * 2, maxMs);
+}
+
+void reactor::RetryTimer::reset()
+{
+    delayMs = initialMs;
+
+    // a pending retry would still use the old delay
+    if(pending)
+    {
+        setTimerFd(fd, 0, 0);
+        readTimerFd(fd);
+        pending = false;
+    }
+}
+
+void reactor::RetryTimer::acknowledge()
+{
+    readTimerFd(fd);
+    pending = false;
+}
+
+bool reactor::RetryTimer::isPending() const
+{
+    return pending;
+}
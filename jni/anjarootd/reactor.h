@@ -0,0 +1,103 @@
+/*
+ * Copyright 2013 Simon Brakhane
+ *
+ * This file is part of AnJaRoot.
+ *
+ * AnJaRoot is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * AnJaRoot is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * AnJaRoot. If not, see http://www.gnu.org/licenses/.
+ */
+
+#ifndef _ANJAROOTD_REACTOR_H_
+#define _ANJAROOTD_REACTOR_H_
+
+#include <functional>
+#include <map>
+#include <signal.h>
+#include <stdint.h>
+#include <sys/epoll.h>
+#include <unistd.h>
+
+namespace reactor
+{
+    // Small epoll wrapper, every registered fd gets a callback which is
+    // invoked with the ready events. Everything runs on the calling thread.
+    class Reactor
+    {
+        public:
+            typedef std::function<void (uint32_t events)> Callback;
+
+            Reactor();
+            ~Reactor();
+
+            // owned fds are closed on remove() or when the reactor dies
+            void add(int fd, uint32_t events, const Callback& callback,
+                    bool owned = false);
+            void remove(int fd);
+
+            // Waits for events and runs the callbacks, timeout in ms (-1
+            // blocks). Returns the number of dispatched events.
+            int poll(int timeout);
+
+        private:
+            struct Entry
+            {
+                Callback callback;
+                bool owned;
+            };
+            typedef std::map<int, Entry> Entries;
+
+            Reactor(const Reactor&);
+            Reactor& operator=(const Reactor&);
+
+            int epfd;
+            Entries entries;
+    };
+
+    // Thin wrappers around syscalls bionic didn't know about for a long time,
+    // all of them return non blocking, close-on-exec fds or -1 with errno set.
+    int openSignalFd(const int* signals, std::size_t count);
+    int readSignalFd(int fd);
+    int openTimerFd();
+    bool setTimerFd(int fd, int valueMs, int intervalMs);
+    uint64_t readTimerFd(int fd);
+    int openPidFd(pid_t pid);
+
+    // One shot timer with exponential backoff: every schedule() doubles the
+    // delay for the next one, up to maxMs. reset() once things work again,
+    // it also cancels a pending retry.
+    class RetryTimer
+    {
+        public:
+            RetryTimer(int initialMs_, int maxMs_);
+            ~RetryTimer();
+
+            int getFd() const;
+            void schedule();
+            void reset();
+            // has to be called when the fd signaled
+            void acknowledge();
+            bool isPending() const;
+
+        private:
+            RetryTimer(const RetryTimer&);
+            RetryTimer& operator=(const RetryTimer&);
+
+            int fd;
+            int initialMs;
+            int maxMs;
+            int delayMs;
+            bool pending;
+    };
+}
+
+#endif
@@ -0,0 +1,211 @@
+/*
+ * Copyright 2013 Simon Brakhane
+ *
+ * This file is part of AnJaRoot.
+ *
+ * AnJaRoot is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * AnJaRoot is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * AnJaRoot. If not, see http://www.gnu.org/licenses/.
+ */
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "stats.h"
+#include "shared/util.h"
+
+// function statics, so registering works regardless of initialization order
+static std::vector<stats::Counter*>& counters()
+{
+    static std::vector<stats::Counter*> list;
+    return list;
+}
+
+static std::vector<stats::HistogramBase*>& histograms()
+{
+    static std::vector<stats::HistogramBase*> list;
+    return list;
+}
+
+stats::Counter::Counter(const char* name_) : name(name_), count(0)
+{
+    counters().push_back(this);
+}
+
+void stats::Counter::add(unsigned long value)
+{
+    count.fetch_add(value, std::memory_order_relaxed);
+}
+
+unsigned long stats::Counter::get() const
+{
+    return count.load(std::memory_order_relaxed);
+}
+
+const char* stats::Counter::getName() const
+{
+    return name;
+}
+
+stats::HistogramBase::HistogramBase(const char* name_) : name(name_)
+{
+    histograms().push_back(this);
+}
+
+stats::HistogramBase::~HistogramBase()
+{
+}
+
+const char* stats::HistogramBase::getName() const
+{
+    return name;
+}
+
+stats::Histogram::Histogram(const char* name_) : HistogramBase(name_)
+{
+    for(int i = 0; i < Buckets; i++)
+    {
+        buckets[i].store(0, std::memory_order_relaxed);
+    }
+}
+
+void stats::Histogram::record(unsigned long value)
+{
+    int bucket = 0;
+    while(value != 0 && bucket < Buckets - 1)
+    {
+        value >>= 1;
+        bucket++;
+    }
+
+    buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+}
+
+int stats::Histogram::getBucketCount() const
+{
+    return Buckets;
+}
+
+unsigned long stats::Histogram::get(int bucket) const
+{
+    return buckets[bucket].load(std::memory_order_relaxed);
+}
+
+unsigned long long stats::Histogram::getUpperBound(int bucket) const
+{
+    // values are at most 32 bit, so even the last one has a bound
+    return bucket == 0 ? 1ULL : 1ULL << bucket;
+}
+
+stats::LogLinearHistogram::LogLinearHistogram(const char* name_) :
+    HistogramBase(name_)
+{
+    for(int i = 0; i < Buckets; i++)
+    {
+        buckets[i].store(0, std::memory_order_relaxed);
+    }
+}
+
+void stats::LogLinearHistogram::record(unsigned long long value)
+{
+    int bucket;
+    if(value < static_cast<unsigned long long>(SubBuckets))
+    {
+        bucket = value;
+    }
+    else if(value > 0xffffffffULL)
+    {
+        bucket = Buckets - 1;
+    }
+    else
+    {
+        // the top bit picks the range, the SubBits below it the bucket
+        int msb = 31 - __builtin_clz(static_cast<uint32_t>(value));
+        int sub = (value >> (msb - SubBits)) & (SubBuckets - 1);
+        bucket = (msb - SubBits + 1) * SubBuckets + sub;
+    }
+
+    buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+}
+
+int stats::LogLinearHistogram::getBucketCount() const
+{
+    return Buckets;
+}
+
+unsigned long stats::LogLinearHistogram::get(int bucket) const
+{
+    return buckets[bucket].load(std::memory_order_relaxed);
+}
+
+unsigned long long stats::LogLinearHistogram::getUpperBound(int bucket) const
+{
+    // anything beyond 32 bit ends up in the last one
+    return bucket == Buckets - 1 ? 0 : getLowerBound(bucket + 1);
+}
+
+unsigned long long stats::LogLinearHistogram::getLowerBound(int bucket)
+{
+    if(bucket < SubBuckets)
+    {
+        return bucket;
+    }
+
+    int range = bucket / SubBuckets;
+    int sub = bucket % SubBuckets;
+    return static_cast<unsigned long long>(SubBuckets + sub) << (range - 1);
+}
+
+void stats::dump()
+{
+    std::vector<Counter*>& clist = counters();
+    for(std::size_t i = 0; i < clist.size(); i++)
+    {
+        LOGV(General, "stats: %s = %lu", clist[i]->getName(),
+                clist[i]->get());
+    }
+
+    std::vector<HistogramBase*>& hlist = histograms();
+    for(std::size_t i = 0; i < hlist.size(); i++)
+    {
+        // only print used buckets, as "<upper bound>:<count>", an open ended
+        // last bucket as ">=<lower bound>:<count>"
+        std::string line;
+        for(int bucket = 0; bucket < hlist[i]->getBucketCount(); bucket++)
+        {
+            unsigned long count = hlist[i]->get(bucket);
+            if(count == 0)
+            {
+                continue;
+            }
+
+            char buf[48];
+            unsigned long long bound = hlist[i]->getUpperBound(bucket);
+            if(bound == 0)
+            {
+                snprintf(buf, sizeof(buf), " >=%llu:%lu",
+                        bucket == 0 ? 0ULL :
+                        hlist[i]->getUpperBound(bucket - 1), count);
+            }
+            else
+            {
+                snprintf(buf, sizeof(buf), " <%llu:%lu", bound, count);
+            }
+            line += buf;
+        }
+
+        LOGV(General, "stats: %s =%s", hlist[i]->getName(),
+                line.empty() ? " empty" : line.c_str());
+    }
+}
@@ -0,0 +1,107 @@
+/*
+ * Copyright 2013 Simon Brakhane
+ *
+ * This file is part of AnJaRoot.
+ *
+ * AnJaRoot is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * AnJaRoot is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * AnJaRoot. If not, see http://www.gnu.org/licenses/.
+ */
+
+#ifndef _ANJAROOTD_STATS_H_
+#define _ANJAROOTD_STATS_H_
+
+#include <atomic>
+
+namespace stats
+{
+    // Statistics are meant to be cheap enough for the hot path: plain relaxed
+    // atomics, no locks. Instances register themselves and have to be static.
+    class Counter
+    {
+        public:
+            Counter(const char* name_);
+
+            void add(unsigned long value = 1);
+            unsigned long get() const;
+            const char* getName() const;
+
+        private:
+            const char* name;
+            std::atomic<unsigned long> count;
+    };
+
+    // What dump() needs to know about a histogram, only the bucket layout
+    // differs between the kinds. Recording never goes through here.
+    class HistogramBase
+    {
+        public:
+            const char* getName() const;
+            virtual int getBucketCount() const = 0;
+            virtual unsigned long get(int bucket) const = 0;
+            // first value beyond bucket, 0 if there is none
+            virtual unsigned long long getUpperBound(int bucket) const = 0;
+
+        protected:
+            HistogramBase(const char* name_);
+            ~HistogramBase();
+
+        private:
+            const char* name;
+    };
+
+    // Buckets are powers of two: bucket 0 counts zeros, bucket n counts
+    // values in [2^(n-1), 2^n).
+    class Histogram : public HistogramBase
+    {
+        public:
+            static const int Buckets = 33;
+
+            Histogram(const char* name_);
+
+            void record(unsigned long value);
+            int getBucketCount() const;
+            unsigned long get(int bucket) const;
+            unsigned long long getUpperBound(int bucket) const;
+
+        private:
+            std::atomic<unsigned long> buckets[Buckets];
+    };
+
+    // Every power of two range is split into SubBuckets linear buckets, which
+    // keeps the relative error below 25% instead of 100%. Values below
+    // SubBuckets get exact buckets, values beyond 32 bit end up in the last.
+    class LogLinearHistogram : public HistogramBase
+    {
+        public:
+            static const int SubBits = 2;
+            static const int SubBuckets = 1 << SubBits;
+            static const int Buckets = (32 - SubBits + 1) * SubBuckets;
+
+            LogLinearHistogram(const char* name_);
+
+            void record(unsigned long long value);
+            int getBucketCount() const;
+            unsigned long get(int bucket) const;
+            unsigned long long getUpperBound(int bucket) const;
+
+            // smallest value that goes into bucket
+            static unsigned long long getLowerBound(int bucket);
+
+        private:
+            std::atomic<unsigned long> buckets[Buckets];
+    };
+
+    void dump();
+}
+
+#endif
@@ -0,0 +1,411 @@
+/*
+ * Copyright 2013 Simon Brakhane
+ *
+ * This file is part of AnJaRoot.
+ *
+ * AnJaRoot is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * AnJaRoot is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * AnJaRoot. If not, see http://www.gnu.org/licenses/.
+ */
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/inotify.h>
+
+#include "supervisor.h"
+#include "flightrecorder.h"
+#include "monotonic.h"
+#include "policy.h"
+#include "prefetch.h"
+#include "stats.h"
+#include "shared/util.h"
+
+static stats::Histogram batchSizes("wait batch size");
+static stats::Counter zygoteAttaches("zygote attaches");
+static stats::Counter debuggerdSpawns("debuggerd spawns");
+static stats::Histogram attachLatency("zygote attach latency (ms)");
+
+// seconds between two maintenance runs
+const int Supervisor::MaintenanceInterval = 600;
+
+// A debuggerd which survived that long (ms) isn't crash looping, the backoff
+// starts from scratch then.
+static const long long DebuggerdStableTime = 60000;
+
+static const char* SocketDir = "/dev/socket";
+
+Supervisor::Supervisor(int signalFd_,
+        const ZygoteChildHandler::Budget& budget) : signalFd(signalFd_),
+    shouldRun(true), reap(true), zygotes(zygoteChilds), debuggerdStarted(0),
+    socketWatchFd(-1), zygoteRetry(100, 5000), debuggerdRetry(1000, 60000)
+{
+    zygoteChilds.setBudget(budget);
+    setupEvents();
+    setupSocketWatch();
+}
+
+Supervisor::~Supervisor()
+{
+}
+
+void Supervisor::setupSocketWatch()
+{
+    // init creates the zygote sockets right before it starts the zygotes,
+    // watching for them lets us attach without polling. If this doesn't work
+    // out the retry timer is all we have.
+    int fd = inotify_init();
+    if(fd == -1)
+    {
+        util::logError("Failed to init inotify for %s: %s", SocketDir,
+                strerror(errno));
+        return;
+    }
+
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    fcntl(fd, F_SETFD, FD_CLOEXEC);
+
+    if(inotify_add_watch(fd, SocketDir, IN_CREATE | IN_MOVED_TO) == -1)
+    {
+        util::logError("Failed to watch %s: %s", SocketDir, strerror(errno));
+        close(fd);
+        return;
+    }
+
+    socketWatchFd = fd;
+    events.add(socketWatchFd, EPOLLIN,
+            [this] (uint32_t) { readSocketEvents(); }, true);
+}
+
+void Supervisor::readSocketEvents()
+{
+    char buf[1024] __attribute__((aligned(__alignof__(struct inotify_event))));
+    bool created = false;
+
+    ssize_t len;
+    while((len = read(socketWatchFd, buf, sizeof(buf))) > 0)
+    {
+        for(char* ptr = buf; ptr < buf + len;)
+        {
+            const struct inotify_event* ev =
+                reinterpret_cast<const struct inotify_event*>(ptr);
+            ptr += sizeof(struct inotify_event) + ev->len;
+
+            if(ev->len > 0 && strstr(ev->name, "zygote") != NULL)
+            {
+                LOGV(Zygote, "Zygote socket %s appeared", ev->name);
+                socketsCreated[std::string(SocketDir) + "/" + ev->name] =
+                    monotonic::nowMs();
+                created = true;
+            }
+        }
+    }
+
+    if(created)
+    {
+        // The zygote may not listen yet, attachZygotes() falls back to the
+        // retry timer then. That one starts over with its shortest delay.
+        zygoteRetry.reset();
+        attachZygotes();
+    }
+}
+
+void Supervisor::setupEvents()
+{
+    // Everything the daemon waits for ends up here: signals (SIGCHLD covers
+    // all ptrace stops), policy changes, pidfds as an extra exit
+    // notification, retry timers and the maintenance timer.
+    events.add(signalFd, EPOLLIN, [this] (uint32_t) { readSignals(); });
+
+    int inotifyFd = policy::getGrantCache().getFd();
+    if(inotifyFd != -1)
+    {
+        events.add(inotifyFd, EPOLLIN, [] (uint32_t)
+                {
+                    policy::getGrantCache().processEvents();
+                    policy::getPrefetcher().notifyPolicyChange();
+                });
+    }
+
+    events.add(zygoteRetry.getFd(), EPOLLIN, [this] (uint32_t)
+            {
+                zygoteRetry.acknowledge();
+                attachZygotes();
+            });
+
+    events.add(debuggerdRetry.getFd(), EPOLLIN, [this] (uint32_t)
+            {
+                debuggerdRetry.acknowledge();
+                spawnDebuggerd();
+            });
+
+    int timerFd = reactor::openTimerFd();
+    if(timerFd != -1 && reactor::setTimerFd(timerFd,
+                MaintenanceInterval * 1000, MaintenanceInterval * 1000))
+    {
+        events.add(timerFd, EPOLLIN, [this, timerFd] (uint32_t)
+                {
+                    reactor::readTimerFd(timerFd);
+                    performMaintenance();
+                }, true);
+    }
+    else
+    {
+        util::logError("Failed to create maintenance timer: %s",
+                strerror(errno));
+        if(timerFd != -1)
+        {
+            close(timerFd);
+        }
+    }
+}
+
+void Supervisor::run()
+{
+    attachZygotes();
+    spawnDebuggerd();
+
+    while(shouldRun)
+    {
+        if(reap)
+        {
+            reap = false;
+            reapChilds();
+            continue;
+        }
+
+        events.poll(-1);
+    }
+}
+
+void Supervisor::readSignals()
+{
+    int signum;
+    while((signum = reactor::readSignalFd(signalFd)) > 0)
+    {
+        if(signum == SIGINT || signum == SIGTERM)
+        {
+            LOGV(General, "Received signal %d, shutting down", signum);
+            shouldRun = false;
+        }
+        else if(signum == SIGCHLD)
+        {
+            reap = true;
+        }
+        else if(signum == SIGUSR1)
+        {
+            LOGV(General, "Dumping flight recorder to %s",
+                    flight::DumpPath);
+            flight::dump(flight::DumpPath);
+        }
+    }
+
+    if(signum == -1)
+    {
+        util::logError("Failed to read signalfd: %s", strerror(errno));
+    }
+}
+
+void Supervisor::performMaintenance()
+{
+    // inotify is handled by the event loop already, this is only the safety
+    // net in case we ever miss a wakeup
+    policy::getGrantCache().processEvents();
+    zygoteChilds.expireParked();
+    stats::dump();
+}
+
+void Supervisor::watchPid(pid_t pid)
+{
+    int pidFd = reactor::openPidFd(pid);
+    if(pidFd == -1)
+    {
+        return;
+    }
+
+    events.add(pidFd, EPOLLIN, [this, pidFd] (uint32_t)
+            {
+                reap = true;
+                events.remove(pidFd);
+            }, true);
+}
+
+void Supervisor::attachZygotes()
+{
+    std::vector<pid_t> attached;
+    bool complete = zygotes.attachAll(attached);
+
+    for(std::vector<pid_t>::const_iterator pid = attached.begin();
+            pid != attached.end(); pid++)
+    {
+        zygoteAttaches.add();
+        watchPid(*pid);
+
+        // only known if we saw the socket appear, not for zygotes which were
+        // already running when we started
+        const std::string& path = zygotes.findByPid(*pid)->getSocketPath();
+        SocketTimes::iterator created = socketsCreated.find(path);
+        if(created != socketsCreated.end())
+        {
+            long long latency = monotonic::nowMs() - created->second;
+            LOGV(Zygote, "Attached to %s %lldms after it appeared",
+                    path.c_str(), latency);
+            attachLatency.record(latency);
+            socketsCreated.erase(created);
+        }
+    }
+
+    // seizing may already have produced stops
+    reap = reap || !attached.empty();
+
+    if(complete)
+    {
+        zygoteRetry.reset();
+    }
+    else
+    {
+        zygoteRetry.schedule();
+    }
+}
+
+void Supervisor::spawnDebuggerd()
+{
+    try
+    {
+        debuggerd.reset(new DebuggerdHandler());
+        debuggerdStarted = monotonic::nowMs();
+        debuggerdSpawns.add();
+        watchPid(debuggerd->getPid());
+    }
+    catch(std::exception& e)
+    {
+        util::logError("Failed to spawn debuggerd: %s", e.what());
+        debuggerdRetry.schedule();
+    }
+}
+
+void Supervisor::reapChilds()
+{
+    // SIGCHLDs get merged, so we keep going till nothing is left
+    while(true)
+    {
+        int err = trace::reapChilds(results, false);
+        if(err == ECHILD)
+        {
+            LOGV(General, "We have no children :(");
+            return;
+        }
+        else if(err == EINTR)
+        {
+            LOGV(General, "We got interrupted in wait()");
+            continue;
+        }
+        else if(err != 0)
+        {
+            util::logError("Failed to wait for children: %s", strerror(err));
+            return;
+        }
+
+        if(results.empty())
+        {
+            return;
+        }
+
+        batchSizes.record(results.size());
+
+        for(trace::WaitResults::const_iterator res = results.begin();
+                res != results.end(); res++)
+        {
+            // one misbehaving tracee mustn't take the others down
+            try
+            {
+                dispatch(*res);
+            }
+            catch(std::exception& e)
+            {
+                util::logError("Failed to handle event of %d: %s",
+                        res->getPid(), e.what());
+                release(res->getPid());
+            }
+        }
+    }
+}
+
+void Supervisor::dispatch(const trace::WaitResult& res)
+{
+    flight::Scope record(res.getPid(), res.getStatus());
+
+    ZygoteHandler* zygote = zygotes.findByPid(res.getPid());
+    if(zygote != NULL)
+    {
+        if(!zygote->handle(res))
+        {
+            // Only this zygote is gone, children and debuggerd stay. The
+            // restarted zygote needs a moment till its socket is back.
+            util::logError("Lost zygote %d, re-attaching", res.getPid());
+            zygotes.remove(res.getPid());
+            zygoteRetry.reset();
+            zygoteRetry.schedule();
+        }
+
+        return;
+    }
+
+    if(debuggerd && res.getPid() == debuggerd->getPid())
+    {
+        if(!debuggerd->handle(res))
+        {
+            if(monotonic::nowMs() - debuggerdStarted >= DebuggerdStableTime)
+            {
+                debuggerdRetry.reset();
+            }
+
+            debuggerd.reset();
+            debuggerdRetry.schedule();
+        }
+
+        return;
+    }
+
+    if(!zygoteChilds.handle(res))
+    {
+        util::logError("Unhandled event of %d", res.getPid());
+    }
+}
+
+// Whoever failed may still sit in a ptrace-stop waiting for us, which nobody
+// would ever end. Let go of it, a zygote gets attached again from scratch.
+void Supervisor::release(pid_t pid)
+{
+    try
+    {
+        if(zygotes.findByPid(pid) != NULL)
+        {
+            util::logError("Dropping zygote %d, re-attaching", pid);
+            zygotes.remove(pid);
+            zygoteRetry.reset();
+            zygoteRetry.schedule();
+            return;
+        }
+
+        // debuggerd is only spawned, not traced, nothing to let go of
+        if(debuggerd && pid == debuggerd->getPid())
+        {
+            return;
+        }
+
+        zygoteChilds.release(pid);
+    }
+    catch(std::exception& e)
+    {
+        util::logError("Failed to release %d: %s", pid, e.what());
+    }
+}
@@ -0,0 +1,85 @@
+/*
+ * Copyright 2013 Simon Brakhane
+ *
+ * This file is part of AnJaRoot.
+ *
+ * AnJaRoot is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * AnJaRoot is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * AnJaRoot. If not, see http://www.gnu.org/licenses/.
+ */
+
+#ifndef _ANJAROOTD_SUPERVISOR_H_
+#define _ANJAROOTD_SUPERVISOR_H_
+
+#include <map>
+#include <memory>
+#include <string>
+
+#include "debuggerdhandler.h"
+#include "reactor.h"
+#include "trace.h"
+#include "zygotechildhandler.h"
+#include "zygotegroup.h"
+
+// Owns everything the daemon traces or spawns and keeps it running. Every
+// component is supervised on its own: a zygote restart only re-attaches that
+// zygote, a crashed debuggerd only gets respawned, traced children survive
+// both. Restarts are retried with backoff.
+class Supervisor
+{
+    public:
+        Supervisor(int signalFd_, const ZygoteChildHandler::Budget& budget);
+        ~Supervisor();
+
+        // returns after SIGINT or SIGTERM
+        void run();
+
+    private:
+        static const int MaintenanceInterval;
+
+        Supervisor(const Supervisor&);
+        Supervisor& operator=(const Supervisor&);
+
+        void setupEvents();
+        void setupSocketWatch();
+        void readSocketEvents();
+        void readSignals();
+        void performMaintenance();
+        void reapChilds();
+        void dispatch(const trace::WaitResult& res);
+        void release(pid_t pid);
+        void attachZygotes();
+        void spawnDebuggerd();
+        void watchPid(pid_t pid);
+
+        int signalFd;
+        bool shouldRun;
+        bool reap;
+        trace::WaitResults results;
+
+        ZygoteChildHandler zygoteChilds;
+        ZygoteGroup zygotes;
+        std::unique_ptr<DebuggerdHandler> debuggerd;
+        // when it got spawned (ms)
+        long long debuggerdStarted;
+
+        // zygote sockets seen appearing, with the time it happened (ms)
+        typedef std::map<std::string, long long> SocketTimes;
+        int socketWatchFd;
+        SocketTimes socketsCreated;
+
+        reactor::RetryTimer zygoteRetry;
+        reactor::RetryTimer debuggerdRetry;
+        reactor::Reactor events;
+};
+
+#endif
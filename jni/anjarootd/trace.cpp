@@ -19,16 +19,51 @@
 #include <algorithm>
 #include <system_error>
 #include <errno.h>
+#include <fcntl.h>
+#include <linux/types.h>
 #include <linux/user.h>
 #include <signal.h>
+#include <stdio.h>
 #include <sys/ptrace.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
 #include <sys/wait.h>
 #include <unistd.h>
 
 #include "trace.h"
+#include "monotonic.h"
 #include "shared/util.h"
 
-trace::Tracee::Tracee(pid_t pid_) : pid(pid_), syscallBegin(false)
+// what PTRACE_GET_SYSCALL_INFO fills in, all offsets are the same on every
+// 32bit platform we support
+struct RawSyscallInfo
+{
+    __u8 op;
+    __u8 pad[3];
+    __u32 arch;
+    __u64 instruction_pointer;
+    __u64 stack_pointer;
+    union
+    {
+        struct
+        {
+            __u64 nr;
+            __u64 args[6];
+        } entry;
+        struct
+        {
+            __s64 rval;
+            __u8 is_error;
+        } exit;
+    };
+};
+
+// unprobed, everything has to work before probeDecoder() ran
+static trace::Decoder decoder = trace::DecodeLegacy;
+
+trace::Tracee::Tracee(pid_t pid_) : pid(pid_), syscallBegin(false),
+    started(false), seized(false), tracedUidKnown(false), tracedUid(-1),
+    origin(0), registersCached(false), syscallInfoCached(false)
 {
 }
 
@@ -41,21 +76,24 @@ pid_t trace::Tracee::getPid() const
     return pid;
 }
 
-bool trace::Tracee::detach() const
+bool trace::Tracee::detach(int signal) const
 {
-    int ret = ptrace(PTRACE_DETACH, pid, NULL, NULL);
+    dropCaches();
+    int ret = ptrace(PTRACE_DETACH, pid, NULL,
+            reinterpret_cast<void*>(signal));
     if(ret == -1)
     {
         util::logError("Failed to detach from %d: %s", pid, strerror(errno));
         return false;
     }
 
-    util::logVerbose("Detached from %d", pid);
+    LOGV(Trace, "Detached from %d", pid);
     return true;
 }
 
 void trace::Tracee::resume(int signal) const
 {
+    dropCaches();
     int ret = ptrace(PTRACE_CONT, pid, NULL, reinterpret_cast<void*>(signal));
     if(ret == -1)
     {
@@ -64,9 +102,23 @@ void trace::Tracee::resume(int signal) const
     }
 }
 
-void trace::Tracee::waitForSyscallResume() const
+void trace::Tracee::listen() const
+{
+    dropCaches();
+    // keeps a seized tracee in its group-stop, but lets us see it continuing
+    int ret = ptrace(PTRACE_LISTEN, pid, NULL, NULL);
+    if(ret == -1)
+    {
+        util::logError("Failed to listen on %d: %s", pid, strerror(errno));
+        throw std::system_error(errno, std::system_category());
+    }
+}
+
+void trace::Tracee::waitForSyscallResume(int signal) const
 {
-    int ret = ptrace(PTRACE_SYSCALL, pid, NULL, NULL);
+    dropCaches();
+    int ret = ptrace(PTRACE_SYSCALL, pid, NULL,
+            reinterpret_cast<void*>(signal));
     if(ret == -1)
     {
         util::logError("Failed to syscall resume %d: %s",
@@ -89,8 +141,11 @@ void trace::Tracee::setupSyscallTrace() const
 
 void trace::Tracee::setupChildTrace() const
 {
+    // Children get auto attached and inherit these options, so they are
+    // ready for syscall tracing right from their first stop.
     int ret = ptrace(PTRACE_SETOPTIONS, pid, NULL,
-            reinterpret_cast<void*>(PTRACE_O_TRACEFORK));
+            reinterpret_cast<void*>(PTRACE_O_TRACEFORK |
+                PTRACE_O_TRACESYSGOOD));
     if(ret == -1)
     {
         util::logError("Failed to setup fork tracing on %d: %s",
@@ -127,6 +182,212 @@ siginfo_t trace::Tracee::getSignalInfo() const
     return result;
 }
 
+const arch::Registers& trace::Tracee::getRegisters() const
+{
+    if(registersCached)
+    {
+        return registers;
+    }
+
+    if(!arch::NativeTraits::fetchRegisters(pid, registers,
+                decoder != DecodeLegacy))
+    {
+        util::logError("Failed to get registers of %d: %s", pid,
+                strerror(errno));
+        throw std::system_error(errno, std::system_category());
+    }
+
+    registersCached = true;
+    return registers;
+}
+
+void trace::Tracee::dropCaches() const
+{
+    registersCached = false;
+    syscallInfoCached = false;
+}
+
+const trace::SyscallInfo& trace::Tracee::getSyscallInfo() const
+{
+    if(syscallInfoCached)
+    {
+        return syscallInfo;
+    }
+
+    RawSyscallInfo raw;
+    memset(&raw, 0, sizeof(raw));
+
+    long ret = ptrace(PTRACE_GET_SYSCALL_INFO, pid,
+            reinterpret_cast<void*>(sizeof(raw)), &raw);
+    if(ret == -1)
+    {
+        util::logError("Failed to get syscall info of %d: %s", pid,
+                strerror(errno));
+        throw std::system_error(errno, std::system_category());
+    }
+
+    SyscallInfo& info = syscallInfo;
+    memset(&info, 0, sizeof(info));
+    info.op = raw.op;
+
+    if(raw.op == SyscallInfo::Entry)
+    {
+        info.number = raw.entry.nr;
+        for(int i = 0; i < 6; i++)
+        {
+            info.args[i] = raw.entry.args[i];
+        }
+    }
+    else if(raw.op == SyscallInfo::Exit)
+    {
+        info.number = -1;
+        info.result = raw.exit.rval;
+    }
+
+    syscallInfoCached = true;
+    return info;
+}
+
+bool trace::Tracee::readMemory(unsigned long addr, void* buf,
+        std::size_t len) const
+{
+    // Tries the cheapest way first: process_vm_readv (3.2+) needs a single
+    // syscall for any size, /proc/<pid>/mem three, PTRACE_PEEKDATA one per
+    // word. Ways the kernel doesn't support are skipped from then on.
+    if(transferVm(addr, buf, len, false) ||
+            transferProcMem(addr, buf, len, false) ||
+            transferPtrace(addr, buf, len, false))
+    {
+        return true;
+    }
+
+    util::logError("Failed to read %u bytes at 0x%lx from %d",
+            static_cast<unsigned int>(len), addr, pid);
+    return false;
+}
+
+bool trace::Tracee::writeMemory(unsigned long addr, const void* buf,
+        std::size_t len) const
+{
+    // see readMemory, it's the same for writes
+    void* data = const_cast<void*>(buf);
+    if(transferVm(addr, data, len, true) ||
+            transferProcMem(addr, data, len, true) ||
+            transferPtrace(addr, data, len, true))
+    {
+        return true;
+    }
+
+    util::logError("Failed to write %u bytes at 0x%lx to %d",
+            static_cast<unsigned int>(len), addr, pid);
+    return false;
+}
+
+bool trace::Tracee::transferVm(unsigned long addr, void* buf,
+        std::size_t len, bool write) const
+{
+    static bool supported = true;
+    if(!supported)
+    {
+        return false;
+    }
+
+    struct iovec local;
+    local.iov_base = buf;
+    local.iov_len = len;
+
+    struct iovec remote;
+    remote.iov_base = reinterpret_cast<void*>(addr);
+    remote.iov_len = len;
+
+    long ret = syscall(write ? __NR_process_vm_writev : __NR_process_vm_readv,
+            pid, &local, 1, &remote, 1, 0);
+    if(ret == -1 && errno == ENOSYS)
+    {
+        LOGV(Trace, "process_vm_readv/writev not supported");
+        supported = false;
+    }
+
+    // partial transfers happen if the range crosses into an unmapped (or
+    // for writes, readonly) page, let the slower ways sort that out
+    return ret == static_cast<long>(len);
+}
+
+bool trace::Tracee::transferProcMem(unsigned long addr, void* buf,
+        std::size_t len, bool write) const
+{
+    // writing needs 2.6.39+, just like with process_vm_writev there's no way
+    // to tell beforehand
+    static bool writeSupported = true;
+    if(write && !writeSupported)
+    {
+        return false;
+    }
+
+    char path[32] = {0, };
+    snprintf(path, sizeof(path), "/proc/%d/mem", pid);
+
+    int fd = open(path, write ? O_WRONLY : O_RDONLY);
+    if(fd == -1)
+    {
+        return false;
+    }
+
+    ssize_t ret = write ? pwrite64(fd, buf, len, addr) :
+        pread64(fd, buf, len, addr);
+    if(ret == -1 && write && errno == EINVAL)
+    {
+        writeSupported = false;
+    }
+
+    close(fd);
+    return ret == static_cast<ssize_t>(len);
+}
+
+bool trace::Tracee::transferPtrace(unsigned long addr, void* buf,
+        std::size_t len, bool write) const
+{
+    // Works on aligned words only. Partial words at both ends are read first
+    // and merged, so we never clobber bytes next to the range.
+    char* data = static_cast<char*>(buf);
+    unsigned long start = addr & ~(sizeof(long) - 1);
+
+    for(unsigned long word = start; word < addr + len; word += sizeof(long))
+    {
+        unsigned long from = std::max(word, addr);
+        unsigned long to = std::min(word + sizeof(long), addr + len);
+
+        long value = 0;
+        if(!write || from != word || to != word + sizeof(long))
+        {
+            errno = 0;
+            value = ptrace(PTRACE_PEEKDATA, pid, reinterpret_cast<void*>(word),
+                    NULL);
+            if(errno)
+            {
+                return false;
+            }
+        }
+
+        char* bytes = reinterpret_cast<char*>(&value);
+        if(!write)
+        {
+            memcpy(data + (from - addr), bytes + (from - word), to - from);
+            continue;
+        }
+
+        memcpy(bytes + (from - word), data + (from - addr), to - from);
+        long ret = ptrace(PTRACE_POKEDATA, pid, reinterpret_cast<void*>(word),
+                reinterpret_cast<void*>(value));
+        if(ret == -1)
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
 bool trace::Tracee::isSyscallBegin() const
 {
     return syscallBegin;
@@ -137,8 +398,71 @@ void trace::Tracee::setSyscallBegin(bool value)
     syscallBegin = value;
 }
 
+bool trace::Tracee::isStarted() const
+{
+    return started;
+}
+
+void trace::Tracee::setStarted(bool value)
+{
+    started = value;
+}
+
+bool trace::Tracee::isSeized() const
+{
+    return seized;
+}
+
+void trace::Tracee::setSeized(bool value)
+{
+    seized = value;
+}
+
+bool trace::Tracee::hasTracedUid() const
+{
+    return tracedUidKnown;
+}
+
+uid_t trace::Tracee::getTracedUid() const
+{
+    return tracedUid;
+}
+
+void trace::Tracee::setTracedUid(uid_t value)
+{
+    tracedUidKnown = true;
+    tracedUid = value;
+}
+
+pid_t trace::Tracee::getOrigin() const
+{
+    return origin;
+}
+
+void trace::Tracee::setOrigin(pid_t value)
+{
+    origin = value;
+}
+
+trace::Tracee::Timeline& trace::Tracee::getTimeline()
+{
+    return timeline;
+}
+
+const trace::Tracee::Timeline& trace::Tracee::getTimeline() const
+{
+    return timeline;
+}
+
+trace::Tracee::Timeline::Timeline() : forked(0), firstStop(0), detached(0),
+    stops(0), stoppedTime(0), outcome(Pending)
+{
+}
+
+// Every result is made right after its wait returned, so this is when it got
+// reaped. Later results of a batch wait behind the earlier ones from here on.
 trace::WaitResult::WaitResult(pid_t pid_, int status_) : pid(pid_),
-    status(status_)
+    status(status_), reaped(monotonic::nowUs())
 {
 }
 
@@ -182,6 +506,11 @@ int trace::WaitResult::getStatus() const
     return status;
 }
 
+long long trace::WaitResult::getReapTime() const
+{
+    return reaped;
+}
+
 bool trace::WaitResult::hasExited() const
 {
     return WIFEXITED(status);
@@ -247,6 +576,92 @@ bool trace::WaitResult::inSyscall() const
     return getStopSignal() == (SIGTRAP | 0x80);
 }
 
+bool trace::WaitResult::isEventStop() const
+{
+    return hasStopped() && getEvent() == PTRACE_EVENT_STOP;
+}
+
+bool trace::WaitResult::isGroupStop() const
+{
+    // seized tracees report a group-stop as PTRACE_EVENT_STOP with the
+    // stopping signal, any other event stop comes with SIGTRAP
+    return isEventStop() && getStopSignal() != SIGTRAP;
+}
+
+bool trace::WaitResult::isInitialStop() const
+{
+    // auto attached children of an attached tracee start with a SIGSTOP,
+    // those of a seized tracee with PTRACE_EVENT_STOP
+    if(!hasStopped())
+    {
+        return false;
+    }
+
+    return getStopSignal() == SIGSTOP || (isEventStop() && !isGroupStop());
+}
+
+trace::Decoder trace::probeDecoder()
+{
+    // Both requests need a stopped tracee to tell whether the kernel knows
+    // them (everything else fails with ESRCH first), so we create one.
+    pid_t pid = fork();
+    if(pid == 0)
+    {
+        ptrace(PTRACE_TRACEME, 0, NULL, NULL);
+        raise(SIGSTOP);
+        _exit(0);
+    }
+    else if(pid == -1)
+    {
+        util::logError("Failed to fork probe process: %s", strerror(errno));
+        decoder = DecodeLegacy;
+        return decoder;
+    }
+
+    int status;
+    waitpid(pid, &status, 0);
+
+    RawSyscallInfo raw;
+    arch::Registers regs;
+    if(ptrace(PTRACE_GET_SYSCALL_INFO, pid,
+                reinterpret_cast<void*>(sizeof(raw)), &raw) > 0)
+    {
+        decoder = DecodeSyscallInfo;
+    }
+    else if(arch::fetchRegset(pid, regs))
+    {
+        decoder = DecodeRegset;
+    }
+    else
+    {
+        decoder = DecodeLegacy;
+    }
+
+    kill(pid, SIGKILL);
+    waitpid(pid, &status, 0);
+
+    LOGV(Trace, "Decoding syscalls with %s", getDecoderName(decoder));
+    return decoder;
+}
+
+trace::Decoder trace::getDecoder()
+{
+    return decoder;
+}
+
+const char* trace::getDecoderName(Decoder value)
+{
+    switch(value)
+    {
+        case DecodeSyscallInfo:
+            return "PTRACE_GET_SYSCALL_INFO";
+        case DecodeRegset:
+            return "PTRACE_GETREGSET";
+        default:
+            return "PTRACE_GETREGS/PTRACE_PEEKUSER";
+    }
+}
+
 trace::Tracee::Ptr trace::attach(pid_t pid)
 {
     int ret = ptrace(PTRACE_ATTACH, pid, NULL, NULL);
@@ -259,6 +674,81 @@ trace::Tracee::Ptr trace::attach(pid_t pid)
     return std::make_shared<Tracee>(pid);
 }
 
+trace::Tracee::Ptr trace::seize(pid_t pid, int options)
+{
+    // Unlike PTRACE_ATTACH this neither stops the process nor sends it a
+    // signal, and the options are active right from the start. Returns NULL
+    // if the kernel doesn't know PTRACE_SEIZE (< 3.4) or the options.
+    int ret = ptrace(PTRACE_SEIZE, pid, NULL, reinterpret_cast<void*>(options));
+    if(ret == -1)
+    {
+        if(errno == EIO || errno == EINVAL)
+        {
+            LOGV(Trace, "Can't seize %d with options 0x%x: %s", pid,
+                    options, strerror(errno));
+            return NULL;
+        }
+
+        util::logError("Failed to seize process: %s", strerror(errno));
+        throw std::system_error(errno, std::system_category());
+    }
+
+    Tracee::Ptr tracee = std::make_shared<Tracee>(pid);
+    tracee->setSeized(true);
+    return tracee;
+}
+
+// waitid hands out a siginfo instead of a status word. For ptrace stops
+// si_status holds what waitpid would put in bits 8 and up (stop signal plus
+// the event), so the status WaitResult decodes can be rebuilt without loss.
+static int toWaitStatus(const siginfo_t& info)
+{
+    switch(info.si_code)
+    {
+        case CLD_EXITED:
+            return (info.si_status & 0xff) << 8;
+        case CLD_KILLED:
+            return info.si_status & 0x7f;
+        case CLD_DUMPED:
+            return (info.si_status & 0x7f) | 0x80;
+        default:
+            // CLD_TRAPPED and CLD_STOPPED
+            return (info.si_status << 8) | 0x7f;
+    }
+}
+
+int trace::reapChilds(WaitResults& results, bool block)
+{
+    // Block for the first event only (if asked to), then collect everything
+    // else which is already pending. A burst of app launches costs one
+    // sleeping wait that way.
+    results.clear();
+
+    int options = WEXITED | WSTOPPED | __WALL;
+    bool first = true;
+    while(true)
+    {
+        siginfo_t info;
+        memset(&info, 0, sizeof(info));
+        int ret = waitid(P_ALL, 0, &info,
+                options | (first && block ? 0 : WNOHANG));
+        if(ret == -1)
+        {
+            // only an error if we got nothing at all
+            return results.empty() ? errno : 0;
+        }
+
+        // WNOHANG with nothing pending leaves si_pid at 0
+        if(info.si_pid == 0)
+        {
+            return 0;
+        }
+
+        results.push_back(WaitResult(info.si_pid, toWaitStatus(info)));
+        first = false;
+    }
+}
+
 trace::WaitResult trace::waitChilds()
 {
     int status;
@@ -24,31 +24,143 @@
 #include <vector>
 #include <unistd.h>
 
+#include "archtraits.h"
+
+#ifndef PTRACE_SEIZE
+#define PTRACE_SEIZE 0x4206
+#endif
+
+#ifndef PTRACE_LISTEN
+#define PTRACE_LISTEN 0x4208
+#endif
+
+#ifndef PTRACE_EVENT_STOP
+#define PTRACE_EVENT_STOP 128
+#endif
+
+#ifndef PTRACE_GET_SYSCALL_INFO
+#define PTRACE_GET_SYSCALL_INFO 0x420e
+#endif
+
 namespace trace {
+    // How syscall stops get decoded, ordered from best to worst. Picked once
+    // at startup by probeDecoder().
+    enum Decoder
+    {
+        // PTRACE_GET_SYSCALL_INFO (5.3+): number, arguments and whether it's
+        // an entry or an exit in a single call
+        DecodeSyscallInfo,
+        // registers through PTRACE_GETREGSET
+        DecodeRegset,
+        // registers through PTRACE_GETREGS or PTRACE_PEEKUSER
+        DecodeLegacy,
+    };
+
+    struct SyscallInfo
+    {
+        enum Op
+        {
+            None = 0,
+            Entry = 1,
+            Exit = 2,
+        };
+
+        int op;
+        long number;
+        unsigned long args[6];
+        long result;
+    };
+
     class Tracee
     {
         public:
             typedef std::shared_ptr<Tracee> Ptr;
             typedef std::vector<Ptr> List;
 
+            // how tracing the tracee ended, as far as the hook is concerned
+            enum Outcome
+            {
+                Pending,
+                Granted,
+                Denied,
+                FastDetached,
+            };
+
+            // What happened when (CLOCK_MONOTONIC us, 0 if it didn't yet),
+            // for the stop budget and the launch statistics.
+            struct Timeline
+            {
+                Timeline();
+
+                long long forked;
+                long long firstStop;
+                long long detached;
+                // stops seen and the time spent handling them
+                unsigned int stops;
+                long long stoppedTime;
+                Outcome outcome;
+            };
+
             Tracee(pid_t pid_);
             ~Tracee();
 
             pid_t getPid() const;
-            bool detach() const;
+            bool detach(int signal = 0) const;
             void resume(int signal = 0) const;
-            void waitForSyscallResume() const;
+            void listen() const;
+            void waitForSyscallResume(int signal = 0) const;
             void setupSyscallTrace() const;
             void setupChildTrace() const;
             unsigned long getEventMsg() const;
             siginfo_t getSignalInfo() const;
+            const arch::Registers& getRegisters() const;
+            const SyscallInfo& getSyscallInfo() const;
+            bool readMemory(unsigned long addr, void* buf,
+                    std::size_t len) const;
+            bool writeMemory(unsigned long addr, const void* buf,
+                    std::size_t len) const;
 
             bool isSyscallBegin() const;
             void setSyscallBegin(bool value);
 
+            bool isStarted() const;
+            void setStarted(bool value);
+            bool isSeized() const;
+            void setSeized(bool value);
+            // uid the tracee switched to, as seen in its setuid family calls
+            bool hasTracedUid() const;
+            uid_t getTracedUid() const;
+            void setTracedUid(uid_t value);
+            // pid of the zygote which forked the tracee, 0 if none
+            pid_t getOrigin() const;
+            void setOrigin(pid_t value);
+            Timeline& getTimeline();
+            const Timeline& getTimeline() const;
+
         private:
+            bool transferVm(unsigned long addr, void* buf, std::size_t len,
+                    bool write) const;
+            bool transferProcMem(unsigned long addr, void* buf,
+                    std::size_t len, bool write) const;
+            bool transferPtrace(unsigned long addr, void* buf,
+                    std::size_t len, bool write) const;
+
             pid_t pid;
             bool syscallBegin;
+            bool started;
+            bool seized;
+            bool tracedUidKnown;
+            uid_t tracedUid;
+            pid_t origin;
+            Timeline timeline;
+
+            void dropCaches() const;
+
+            // fetched at most once per stop, dropped whenever the tracee runs
+            mutable arch::Registers registers;
+            mutable bool registersCached;
+            mutable SyscallInfo syscallInfo;
+            mutable bool syscallInfoCached;
     };
 
     class WaitResult
@@ -59,6 +171,8 @@ namespace trace {
 
             pid_t getPid() const;
             int getStatus() const;
+            // CLOCK_MONOTONIC us
+            long long getReapTime() const;
             bool hasExited() const;
             int getExitStatus() const;
             bool wasSignaled() const;
@@ -68,13 +182,25 @@ namespace trace {
             int getStopSignal() const;
             int getEvent() const;
             bool inSyscall() const;
+            bool isEventStop() const;
+            bool isGroupStop() const;
+            bool isInitialStop() const;
 
         private:
             pid_t pid;
             int status;
+            long long reaped;
     };
 
+    typedef std::vector<WaitResult> WaitResults;
+
+    Decoder probeDecoder();
+    Decoder getDecoder();
+    const char* getDecoderName(Decoder decoder);
+
     Tracee::Ptr attach(pid_t pid);
+    Tracee::Ptr seize(pid_t pid, int options);
+    int reapChilds(WaitResults& results, bool block = true);
     WaitResult waitChilds();
     WaitResult waitChild(pid_t pid);
 }
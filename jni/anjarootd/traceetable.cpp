@@ -0,0 +1,144 @@
+/*
+ * Copyright 2013 Simon Brakhane
+ *
+ * This file is part of AnJaRoot.
+ *
+ * AnJaRoot is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * AnJaRoot is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * AnJaRoot. If not, see http://www.gnu.org/licenses/.
+ */
+
+#include "traceetable.h"
+
+const int trace::TraceeTable::Empty;
+
+trace::TraceeTable::TraceeTable(std::size_t capacity_) :
+    records(capacity_, Tracee(0))
+{
+    // keep the load factor at or below 0.5, probe sequences stay short
+    std::size_t size = 1;
+    while(size < capacity_ * 2)
+    {
+        size <<= 1;
+    }
+
+    buckets.assign(size, Empty);
+    mask = size - 1;
+
+    handles.reserve(capacity_);
+    freeSlots.reserve(capacity_);
+    for(std::size_t i = 0; i < capacity_; i++)
+    {
+        // the records are owned by the table, the handles must never free them
+        handles.push_back(Tracee::Ptr(&records[i], [] (Tracee*) {}));
+        freeSlots.push_back(capacity_ - i - 1);
+    }
+}
+
+trace::TraceeTable::~TraceeTable()
+{
+}
+
+trace::Tracee::Ptr trace::TraceeTable::insert(pid_t pid)
+{
+    std::size_t bucket = lookup(pid);
+    if(buckets[bucket] != Empty)
+    {
+        // reuse the existing record, the old one is stale anyway
+        int slot = buckets[bucket];
+        records[slot] = Tracee(pid);
+        return handles[slot];
+    }
+
+    if(freeSlots.empty())
+    {
+        return NULL;
+    }
+
+    int slot = freeSlots.back();
+    freeSlots.pop_back();
+
+    records[slot] = Tracee(pid);
+    buckets[bucket] = slot;
+    return handles[slot];
+}
+
+trace::Tracee::Ptr trace::TraceeTable::find(pid_t pid) const
+{
+    int slot = buckets[lookup(pid)];
+    if(slot == Empty)
+    {
+        return NULL;
+    }
+
+    return handles[slot];
+}
+
+bool trace::TraceeTable::erase(pid_t pid)
+{
+    std::size_t hole = lookup(pid);
+    if(buckets[hole] == Empty)
+    {
+        return false;
+    }
+
+    freeSlots.push_back(buckets[hole]);
+    buckets[hole] = Empty;
+
+    // Backward shift: move every following entry of the probe sequence into
+    // the hole if its home bucket allows it, so lookups never need tombstones.
+    std::size_t next = (hole + 1) & mask;
+    while(buckets[next] != Empty)
+    {
+        std::size_t home = bucketOf(records[buckets[next]].getPid());
+        if(((next - home) & mask) >= ((next - hole) & mask))
+        {
+            buckets[hole] = buckets[next];
+            buckets[next] = Empty;
+            hole = next;
+        }
+
+        next = (next + 1) & mask;
+    }
+
+    return true;
+}
+
+std::size_t trace::TraceeTable::size() const
+{
+    return records.size() - freeSlots.size();
+}
+
+std::size_t trace::TraceeTable::capacity() const
+{
+    return records.size();
+}
+
+std::size_t trace::TraceeTable::bucketOf(pid_t pid) const
+{
+    // pids are handed out sequentially, a multiplicative hash spreads them
+    return (static_cast<unsigned int>(pid) * 2654435761U) & mask;
+}
+
+std::size_t trace::TraceeTable::lookup(pid_t pid) const
+{
+    // returns either the bucket holding pid or the empty one ending its probe
+    // sequence, there is always an empty bucket as the table is never full
+    std::size_t bucket = bucketOf(pid);
+    while(buckets[bucket] != Empty &&
+            records[buckets[bucket]].getPid() != pid)
+    {
+        bucket = (bucket + 1) & mask;
+    }
+
+    return bucket;
+}
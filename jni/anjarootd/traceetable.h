@@ -0,0 +1,75 @@
+/*
+ * Copyright 2013 Simon Brakhane
+ *
+ * This file is part of AnJaRoot.
+ *
+ * AnJaRoot is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * AnJaRoot is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * AnJaRoot. If not, see http://www.gnu.org/licenses/.
+ */
+
+#ifndef _ANJAROOTD_TRACEETABLE_H_
+#define _ANJAROOTD_TRACEETABLE_H_
+
+#include <vector>
+#include <unistd.h>
+
+#include "trace.h"
+
+namespace trace {
+    // Fixed size pool of Tracee records, indexed by pid through an open
+    // addressing hash table (linear probing, backward shift deletion). Every
+    // operation is O(1) and nothing is allocated after construction, the
+    // handed out pointers are created once per slot and reused.
+    //
+    // A Ptr is only valid till the tracee gets erased, its slot is recycled
+    // for the next insert.
+    class TraceeTable
+    {
+        public:
+            TraceeTable(std::size_t capacity_);
+            ~TraceeTable();
+
+            Tracee::Ptr insert(pid_t pid);
+            Tracee::Ptr find(pid_t pid) const;
+            bool erase(pid_t pid);
+
+            std::size_t size() const;
+            std::size_t capacity() const;
+
+            template<typename Func>
+            void forEach(Func func) const
+            {
+                for(std::size_t i = 0; i < buckets.size(); i++)
+                {
+                    if(buckets[i] != Empty)
+                    {
+                        func(handles[buckets[i]]);
+                    }
+                }
+            }
+
+        private:
+            static const int Empty = -1;
+
+            std::size_t bucketOf(pid_t pid) const;
+            std::size_t lookup(pid_t pid) const;
+
+            std::vector<Tracee> records;
+            std::vector<Tracee::Ptr> handles;
+            std::vector<int> freeSlots;
+            std::vector<int> buckets;
+            std::size_t mask;
+    };
+}
+
+#endif
@@ -20,40 +20,253 @@
 #include <algorithm>
 
 #include "zygotechildhandler.h"
+#include "flightrecorder.h"
 #include "hook.h"
+#include "monotonic.h"
+#include "packages.h"
+#include "policysnapshot.h"
+#include "stats.h"
 #include "shared/util.h"
 
-ZygoteChildHandler::ZygoteChildHandler()
+// Children are only traced till their capset, so even launch storms won't get
+// anywhere near this.
+const std::size_t ZygoteChildHandler::MaxChilds = 1024;
+
+// The fork event is reported right after the initial stop of the child, if
+// it didn't show up by then it never will (the zygote got lost).
+const long long ZygoteChildHandler::ParkTimeout = 10000000;
+
+static stats::Counter budgetExceeded("budget exceeded");
+
+namespace
+{
+    // how a launch went, one set per outcome
+    struct LaunchHistograms
+    {
+        LaunchHistograms(const char* total, const char* stopped,
+                const char* stops) : totalTime(total), stoppedTime(stopped),
+            stopCount(stops)
+        {
+        }
+
+        stats::LogLinearHistogram totalTime;
+        stats::LogLinearHistogram stoppedTime;
+        stats::LogLinearHistogram stopCount;
+    };
+}
+
+static LaunchHistograms grantedLaunches(
+        "launch granted: fork to detach (us)",
+        "launch granted: time stopped (us)",
+        "launch granted: stops");
+static LaunchHistograms deniedLaunches(
+        "launch denied: fork to detach (us)",
+        "launch denied: time stopped (us)",
+        "launch denied: stops");
+static LaunchHistograms fastDetachedLaunches(
+        "launch fast-detached: fork to detach (us)",
+        "launch fast-detached: time stopped (us)",
+        "launch fast-detached: stops");
+static stats::LogLinearHistogram firstStopDelay(
+        "launch: fork to first stop (us)");
+static stats::LogLinearHistogram capsetDelay(
+        "launch: first stop to capset (us)");
+
+// Children that exited or that we gave up on didn't finish a launch as far
+// as we are concerned, they only count in the flight recorder.
+static void recordLaunch(const trace::Tracee::Timeline& timeline,
+        long long lastStop)
+{
+    LaunchHistograms* histograms = 0;
+    switch(timeline.outcome)
+    {
+        case trace::Tracee::Granted:
+            histograms = &grantedLaunches;
+            break;
+        case trace::Tracee::Denied:
+            histograms = &deniedLaunches;
+            break;
+        case trace::Tracee::FastDetached:
+            histograms = &fastDetachedLaunches;
+            break;
+        default:
+            return;
+    }
+
+    histograms->totalTime.record(
+            monotonic::elapsed(timeline.forked, timeline.detached));
+    histograms->stoppedTime.record(timeline.stoppedTime);
+    histograms->stopCount.record(timeline.stops);
+    firstStopDelay.record(
+            monotonic::elapsed(timeline.forked, timeline.firstStop));
+
+    // granted or not is decided in the capset stop, which is the last one
+    if(timeline.outcome != trace::Tracee::FastDetached)
+    {
+        capsetDelay.record(monotonic::elapsed(timeline.firstStop, lastStop));
+    }
+}
+
+ZygoteChildHandler::ZygoteChildHandler() : childs(MaxChilds)
+{
+}
+
+// A child makes a few hundred syscalls till its capset, so this only trips if
+// it never gets there.
+ZygoteChildHandler::Budget::Budget() : maxStops(10000), maxMillis(10000)
 {
 }
 
 ZygoteChildHandler::~ZygoteChildHandler()
 {
-    util::logVerbose("Detaching from zygote children...");
-    std::for_each(childs.begin(), childs.end(),
-            [] (trace::Tracee::Ptr x) { x->detach(); });
+    LOGV(Zygote, "Detaching from zygote children...");
+    childs.forEach([] (const trace::Tracee::Ptr& x) { x->detach(); });
+    std::for_each(earlyStops.begin(), earlyStops.end(),
+            [] (const ParkedPid& x) { trace::Tracee(x.pid).detach(); });
+}
+
+void ZygoteChildHandler::addChild(pid_t pid, pid_t zygotePid,
+        long long forked)
+{
+    // The child was auto attached by the kernel and inherited all trace
+    // options from zygote. startChild trims them once the initial stop, which
+    // may already have happened, shows up.
+    // a recycled pid, whatever we remembered is about somebody else
+    unpark(rejected, pid);
+
+    trace::Tracee::Ptr child = childs.insert(pid);
+    if(!child)
+    {
+        util::logError("Too many zygote children, not tracing %d", pid);
+        rejectChild(pid);
+        return;
+    }
+    child->setOrigin(zygotePid);
+
+    trace::Tracee::Timeline& timeline = child->getTimeline();
+    timeline.forked = forked;
+
+    if(unpark(earlyStops, pid))
+    {
+        // it stopped before we knew it, sometime before now
+        timeline.firstStop = timeline.forked;
+        timeline.stops++;
+        startChild(child);
+
+        if(timeline.detached != 0)
+        {
+            recordLaunch(timeline, timeline.forked);
+        }
+    }
+}
+
+void ZygoteChildHandler::release(pid_t pid)
+{
+    trace::Tracee::Ptr child = childs.find(pid);
+    if(child)
+    {
+        releaseChild(child);
+        return;
+    }
+
+    // Not in the table (yet), but the kernel attached it for us anyway
+    rejectChild(pid);
+}
+
+void ZygoteChildHandler::rejectChild(pid_t pid)
+{
+    if(unpark(earlyStops, pid))
+    {
+        // already sits in its initial stop
+        trace::Tracee(pid).detach();
+        return;
+    }
+
+    // Detaching only works in a stop, till then it would just fail with
+    // ESRCH. So it happens at the first one, see handle.
+    ParkedPid parked = {pid, monotonic::nowUs()};
+    rejected.push_back(parked);
+}
+
+bool ZygoteChildHandler::unpark(ParkedPids& parked, pid_t pid)
+{
+    for(ParkedPids::iterator iter = parked.begin(); iter != parked.end();
+            iter++)
+    {
+        if(iter->pid == pid)
+        {
+            parked.erase(iter);
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void ZygoteChildHandler::expireParked()
+{
+    long long now = monotonic::nowUs();
+    for(ParkedPids::iterator iter = earlyStops.begin();
+            iter != earlyStops.end();)
+    {
+        if(monotonic::elapsed(iter->since, now) > ParkTimeout)
+        {
+            util::logError("No fork event for child %d, detaching",
+                    iter->pid);
+            trace::Tracee(iter->pid).detach();
+            iter = earlyStops.erase(iter);
+        }
+        else
+        {
+            iter++;
+        }
+    }
+
+    // Those never stopped at all, most likely they are long gone
+    for(ParkedPids::iterator iter = rejected.begin();
+            iter != rejected.end();)
+    {
+        if(monotonic::elapsed(iter->since, now) > ParkTimeout)
+        {
+            iter = rejected.erase(iter);
+        }
+        else
+        {
+            iter++;
+        }
+    }
+}
+
+void ZygoteChildHandler::setBudget(const Budget& value)
+{
+    budget = value;
 }
 
 bool ZygoteChildHandler::handle(const trace::WaitResult& res)
 {
     // first find out if we already know about this child
-    auto found = searchChildByPid(res.getPid());
-    if(found == childs.end())
+    trace::Tracee::Ptr child = childs.find(res.getPid());
+    if(!child)
     {
-        if(res.getStopSignal() == SIGSTOP)
+        if(unpark(rejected, res.getPid()))
+        {
+            // first stop of a child we couldn't take, see rejectChild
+            if(res.hasStopped())
+            {
+                trace::Tracee(res.getPid()).detach();
+            }
+            return true;
+        }
+
+        if(res.isInitialStop())
         {
-            // TODO: someone stopped we don't know about till now? Maybe we can
-            // check who's the parent of the child to decide if we should attach
-            // to it or not. We could parse proc, but that's ugly as hell...
-            pid_t newpid = res.getPid();
-
-            util::logVerbose("SIGSTOP for untracked child %d received, "
-                    "starting trace", newpid);
-
-            trace::Tracee::Ptr child = std::make_shared<trace::Tracee>(newpid);
-            child->setupSyscallTrace();
-            child->waitForSyscallResume();
-            childs.push_back(child);
+            // The initial stop of a new child raced ahead of the fork event
+            // of its parent. Park it till zygote reports it, see addChild.
+            LOGV(Zygote, "Initial stop of untracked child %d received, "
+                    "waiting for fork event", res.getPid());
+            expireParked();
+            ParkedPid parked = {res.getPid(), monotonic::nowUs()};
+            earlyStops.push_back(parked);
             return true;
         }
 
@@ -62,37 +275,99 @@ bool ZygoteChildHandler::handle(const trace::WaitResult& res)
         return true;
     }
 
+    // Everything but the end of the child is a stop it waits in for us,
+    // counted from when it got reaped. That includes waiting behind earlier
+    // results of the same batch, only the time between the kernel stopping
+    // it and the wait returning can't be seen from here.
+    long long reaped = res.getReapTime();
+    trace::Tracee::Timeline& timeline = child->getTimeline();
+    bool stopped = !res.hasExited() && !res.wasSignaled();
+    if(stopped)
+    {
+        timeline.stops++;
+        if(timeline.firstStop == 0)
+        {
+            timeline.firstStop = reaped;
+        }
+    }
+
+    bool result = handleChild(child, res);
+
+    if(stopped)
+    {
+        timeline.stoppedTime += monotonic::elapsed(reaped,
+                monotonic::nowUs());
+    }
+
+    if(timeline.detached != 0)
+    {
+        recordLaunch(timeline, reaped);
+    }
+
+    return result;
+}
+
+bool ZygoteChildHandler::handleChild(const trace::Tracee::Ptr& child,
+        const trace::WaitResult& res)
+{
     if(res.hasExited())
     {
-        util::logVerbose("Zygote child exited with status: %d",
+        LOGV(Zygote, "Zygote child exited with status: %d",
                 res.getExitStatus());
+        flight::noteDecision(flight::Exited);
 
-        found->get()->detach();
-        childs.erase(found);
+        releaseChild(child);
         return true;
     }
 
     if(res.wasSignaled())
     {
-        util::logVerbose("Zygote child received termination signal: %d",
+        LOGV(Zygote, "Zygote child received termination signal: %d",
                 res.getTermSignal());
+        flight::noteDecision(flight::Exited);
+
+        releaseChild(child);
+        return true;
+    }
+
+    if(!child->isStarted() && res.isInitialStop())
+    {
+        startChild(child);
+        return true;
+    }
 
-        found->get()->detach();
-        childs.erase(found);
+    if(res.isGroupStop())
+    {
+        LOGV(Zygote, "Zygote child %d entered group-stop (signal %d)",
+                child->getPid(), res.getStopSignal());
+        child->listen();
+        return true;
+    }
+
+    if(res.isEventStop())
+    {
+        // continued after a group-stop, there is no signal to deliver
+        resumeChild(child);
+        return true;
+    }
+
+    // Checked only now, detaching in a group or event stop would mess up
+    // job control. What's left is a syscall or a signal-delivery stop, and
+    // the latter still owes the child its signal.
+    if(isOverBudget(child))
+    {
+        reportBudgetExceeded(child);
+        flight::noteDecision(flight::BudgetExceeded);
+        releaseChild(child, res.inSyscall() ? 0 : res.getStopSignal());
         return true;
     }
 
     if(res.inSyscall())
     {
-        bool detach = hook::performHookActions(*found);
+        bool detach = handleSyscall(child);
         if(detach)
         {
-            found->get()->detach();
-            childs.erase(found);
-        }
-        else
-        {
-            found->get()->waitForSyscallResume();
+            releaseChild(child);
         }
 
         return true;
@@ -100,9 +375,9 @@ bool ZygoteChildHandler::handle(const trace::WaitResult& res)
 
     if(res.hasStopped())
     {
-        util::logVerbose("Zygote child received stop signal %d, deliver it",
+        LOGV(Zygote, "Zygote child received stop signal %d, deliver it",
                 res.getStopSignal());
-        found->get()->resume(res.getStopSignal());
+        resumeChild(child, res.getStopSignal());
         return true;
     }
 
@@ -111,31 +386,119 @@ bool ZygoteChildHandler::handle(const trace::WaitResult& res)
     return false;
 }
 
-trace::Tracee::Ptr ZygoteChildHandler::getChildByPid(pid_t pid)
+bool ZygoteChildHandler::handleSyscall(const trace::Tracee::Ptr& child)
+{
+    long syscallnum = -1;
+    bool detach = hook::performHookActions(child, syscallnum);
+
+    // The uid is known from here on, there's no point in stepping through
+    // the rest if capset won't change anything.
+    if(!detach && child->hasTracedUid() && hook::isSetUidSyscall(syscallnum))
+    {
+        hook::DetachReason reason =
+            hook::checkFastDetach(child->getTracedUid());
+        if(reason != hook::KeepTracing)
+        {
+            child->getTimeline().outcome = trace::Tracee::FastDetached;
+            hook::recordFastDetach(reason);
+            return true;
+        }
+    }
+
+    if(detach)
+    {
+        return true;
+    }
+
+    child->waitForSyscallResume();
+    return false;
+}
+
+bool ZygoteChildHandler::isOverBudget(const trace::Tracee::Ptr& child) const
+{
+    const trace::Tracee::Timeline& timeline = child->getTimeline();
+    if(budget.maxStops != 0 && timeline.stops > budget.maxStops)
+    {
+        return true;
+    }
+
+    return budget.maxMillis != 0 &&
+        monotonic::elapsed(timeline.forked, monotonic::nowUs()) / 1000 >
+        budget.maxMillis;
+}
+
+void ZygoteChildHandler::reportBudgetExceeded(
+        const trace::Tracee::Ptr& child) const
 {
-    auto found = searchChildByPid(pid);
-    if(found != childs.end())
+    budgetExceeded.add();
+
+    uid_t uid = -1;
+    if(child->hasTracedUid())
     {
-        return *found;
+        uid = child->getTracedUid();
+    }
+    else
+    {
+        try
+        {
+            uid = hook::getUidFromPid(child->getPid());
+        }
+        catch(std::exception& e)
+        {
+            // already logged, go with the unknown uid
+        }
     }
 
-    return NULL;
+    // rare enough to afford parsing packages.list right here
+    std::string name = "unknown";
+    if(uid != static_cast<uid_t>(-1))
+    {
+        packages::PackageList packages;
+        const packages::Package* pkg =
+            packages.findByUid(uid % policy::PerUserRange);
+        if(pkg)
+        {
+            name = pkg->pkgName.str();
+        }
+    }
+
+    util::logError("Budget exceeded by zygote child %d (uid %d, package %s) "
+            "after %u stops and %llu ms, detaching", child->getPid(),
+            static_cast<int>(uid), name.c_str(), child->getTimeline().stops,
+            monotonic::elapsed(child->getTimeline().forked,
+                monotonic::nowUs()) / 1000);
 }
 
-void ZygoteChildHandler::removeChildByPid(pid_t pid)
+void ZygoteChildHandler::startChild(const trace::Tracee::Ptr& child)
 {
-    auto found = searchChildByPid(pid);
-    if(found != childs.end())
+    // Nobody granted means nothing to do for any child, let it go right away.
+    // That includes the granter, it only needs its capabilities to kill the
+    // processes of revoked packages and with nothing granted there are none.
+    if(!hook::hasGrants())
     {
-        found->get()->detach();
-        childs.erase(found);
+        child->getTimeline().outcome = trace::Tracee::FastDetached;
+        hook::recordFastDetach(hook::DetachNoGrants);
+        releaseChild(child);
+        return;
     }
+
+    // Zygote's options came along with the auto attach, TRACEFORK included.
+    // Whatever the child forks is none of our business, so it goes.
+    child->setupSyscallTrace();
+    child->setStarted(true);
+    child->waitForSyscallResume();
 }
 
-trace::Tracee::List::iterator ZygoteChildHandler::searchChildByPid(pid_t pid)
+void ZygoteChildHandler::releaseChild(const trace::Tracee::Ptr& child,
+        int signal)
 {
-    auto comperator = [=] (trace::Tracee::Ptr tracee)
-    { return tracee->getPid() == pid; };
-    return std::find_if(childs.begin(), childs.end(), comperator);
+    child->detach(signal);
+    childs.erase(child->getPid());
+    child->getTimeline().detached = monotonic::nowUs();
 }
 
+void ZygoteChildHandler::resumeChild(const trace::Tracee::Ptr& child,
+        int signal)
+{
+    child->waitForSyscallResume(signal);
+}
@@ -20,22 +20,66 @@
 #ifndef _ANJAROOTD_ZYGOTECHILDHANDLER_H_
 #define _ANJAROOTD_ZYGOTECHILDHANDLER_H_
 
+#include <vector>
+
 #include "trace.h"
+#include "traceetable.h"
 
 class ZygoteChildHandler
 {
     public:
+        // How long a child may be traced the slow way before we give up on
+        // it, 0 means no limit.
+        struct Budget
+        {
+            Budget();
+
+            unsigned int maxStops;
+            unsigned int maxMillis;
+        };
+
         ZygoteChildHandler();
         ~ZygoteChildHandler();
 
         bool handle(const trace::WaitResult& res);
-        trace::Tracee::Ptr getChildByPid(pid_t pid);
-        void removeChildByPid(pid_t pid);
+        // forked is when zygote's fork event got reaped (us)
+        void addChild(pid_t pid, pid_t zygotePid, long long forked);
+        // let go of a child whose event couldn't be handled
+        void release(pid_t pid);
+        void setBudget(const Budget& value);
+        // gives up on pids parked for too long
+        void expireParked();
 
     private:
-        trace::Tracee::List::iterator searchChildByPid(pid_t pid);
+        static const std::size_t MaxChilds;
+        static const long long ParkTimeout;
+
+        // pids waiting for an event of their own, with the time they started
+        // to wait (us)
+        struct ParkedPid
+        {
+            pid_t pid;
+            long long since;
+        };
+        typedef std::vector<ParkedPid> ParkedPids;
+
+        bool handleChild(const trace::Tracee::Ptr& child,
+                const trace::WaitResult& res);
+        bool handleSyscall(const trace::Tracee::Ptr& child);
+        void startChild(const trace::Tracee::Ptr& child);
+        void resumeChild(const trace::Tracee::Ptr& child, int signal = 0);
+        void releaseChild(const trace::Tracee::Ptr& child, int signal = 0);
+        bool isOverBudget(const trace::Tracee::Ptr& child) const;
+        void reportBudgetExceeded(const trace::Tracee::Ptr& child) const;
+        void rejectChild(pid_t pid);
+        static bool unpark(ParkedPids& parked, pid_t pid);
 
-        trace::Tracee::List childs;
+        trace::TraceeTable childs;
+        // initial stops that came before zygote's fork event
+        ParkedPids earlyStops;
+        // children we can't take, detached at their first stop
+        ParkedPids rejected;
+        Budget budget;
 };
 
 #endif
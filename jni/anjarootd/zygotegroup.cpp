@@ -0,0 +1,184 @@
+/*
+ * Copyright 2013 Simon Brakhane
+ *
+ * This file is part of AnJaRoot.
+ *
+ * AnJaRoot is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * AnJaRoot is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * AnJaRoot. If not, see http://www.gnu.org/licenses/.
+ */
+#include <algorithm>
+
+#include <dirent.h>
+#include <errno.h>
+#include <string.h>
+
+#include "zygotegroup.h"
+#include "shared/util.h"
+
+static const char* SocketDir = "/dev/socket";
+
+ZygoteGroup::ZygoteGroup(ZygoteChildHandler& childhandler_) :
+    childhandler(childhandler_)
+{
+}
+
+ZygoteGroup::~ZygoteGroup()
+{
+}
+
+ZygoteGroup::SocketPaths ZygoteGroup::findSockets()
+{
+    SocketPaths paths;
+
+    DIR* dir = opendir(SocketDir);
+    if(dir == NULL)
+    {
+        util::logError("Failed to open %s: %s", SocketDir, strerror(errno));
+        return paths;
+    }
+
+    // zygote, zygote_secondary, webview_zygote, ... the usap pool sockets
+    // don't belong to a zygote process, they aren't matched.
+    struct dirent* entry;
+    while((entry = readdir(dir)) != NULL)
+    {
+        if(strstr(entry->d_name, "zygote") != NULL)
+        {
+            paths.push_back(std::string(SocketDir) + "/" + entry->d_name);
+        }
+    }
+    closedir(dir);
+
+    // the primary zygote first, it's the one which matters most
+    std::sort(paths.begin(), paths.end());
+    std::string primary = std::string(SocketDir) + "/zygote";
+    SocketPaths::iterator iter = std::find(paths.begin(), paths.end(),
+            primary);
+    if(iter != paths.end())
+    {
+        std::rotate(paths.begin(), iter, iter + 1);
+    }
+
+    return paths;
+}
+
+bool ZygoteGroup::isAttached(const std::string& socketPath) const
+{
+    if(aliases.find(socketPath) != aliases.end())
+    {
+        return true;
+    }
+
+    for(Handlers::const_iterator iter = handlers.begin();
+            iter != handlers.end(); iter++)
+    {
+        if((*iter)->getSocketPath() == socketPath)
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+bool ZygoteGroup::attachAll(std::vector<pid_t>& attached)
+{
+    bool complete = true;
+    std::string primary = std::string(SocketDir) + "/zygote";
+
+    SocketPaths paths = findSockets();
+    for(SocketPaths::const_iterator path = paths.begin(); path != paths.end();
+            path++)
+    {
+        if(isAttached(*path))
+        {
+            continue;
+        }
+
+        try
+        {
+            // Two sockets may lead to the same process, remember that so
+            // the next pass doesn't have to ask the socket again.
+            pid_t pid = ZygoteHandler::getZygotePid(*path);
+            if(findByPid(pid) != NULL)
+            {
+                aliases[*path] = pid;
+                continue;
+            }
+
+            std::unique_ptr<ZygoteHandler> handler(
+                    new ZygoteHandler(childhandler, *path));
+            byPid[handler->getPid()] = handler.get();
+            attached.push_back(handler->getPid());
+            handlers.push_back(std::move(handler));
+        }
+        catch(std::exception& e)
+        {
+            util::logError("Failed to attach to %s: %s", path->c_str(),
+                    e.what());
+            complete = false;
+        }
+    }
+
+    if(!isAttached(primary))
+    {
+        util::logError("Primary zygote not traced");
+        complete = false;
+    }
+
+    return complete;
+}
+
+void ZygoteGroup::remove(pid_t pid)
+{
+    byPid.erase(pid);
+    for(Aliases::iterator iter = aliases.begin(); iter != aliases.end();)
+    {
+        if(iter->second == pid)
+        {
+            iter = aliases.erase(iter);
+        }
+        else
+        {
+            iter++;
+        }
+    }
+
+    for(Handlers::iterator iter = handlers.begin(); iter != handlers.end();
+            iter++)
+    {
+        if((*iter)->getPid() == pid)
+        {
+            handlers.erase(iter);
+            return;
+        }
+    }
+}
+
+ZygoteHandler* ZygoteGroup::findByPid(pid_t pid) const
+{
+    PidIndex::const_iterator iter = byPid.find(pid);
+    return iter != byPid.end() ? iter->second : NULL;
+}
+
+std::vector<pid_t> ZygoteGroup::getPids() const
+{
+    std::vector<pid_t> pids;
+    for(Handlers::const_iterator iter = handlers.begin();
+            iter != handlers.end(); iter++)
+    {
+        pids.push_back((*iter)->getPid());
+    }
+
+    return pids;
+}
@@ -0,0 +1,70 @@
+/*
+ * Copyright 2013 Simon Brakhane
+ *
+ * This file is part of AnJaRoot.
+ *
+ * AnJaRoot is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * AnJaRoot is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * AnJaRoot. If not, see http://www.gnu.org/licenses/.
+ */
+
+#ifndef _ANJAROOTD_ZYGOTEGROUP_H_
+#define _ANJAROOTD_ZYGOTEGROUP_H_
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "trace.h"
+#include "zygotehandler.h"
+#include "zygotechildhandler.h"
+
+// All zygotes we trace: the primary one, the secondary one on 64bit devices
+// and whatever else announces itself with a zygote socket (webview_zygote,
+// ...). Children of all of them share one ZygoteChildHandler.
+class ZygoteGroup
+{
+    public:
+        typedef std::vector<std::string> SocketPaths;
+
+        ZygoteGroup(ZygoteChildHandler& childhandler_);
+        ~ZygoteGroup();
+
+        // Attaches to every zygote not traced yet, the new pids are appended
+        // to attached. Returns false if any zygote couldn't be attached or
+        // the primary one is missing, it's worth another try later then.
+        bool attachAll(std::vector<pid_t>& attached);
+        void remove(pid_t pid);
+        ZygoteHandler* findByPid(pid_t pid) const;
+        std::vector<pid_t> getPids() const;
+
+        static SocketPaths findSockets();
+
+    private:
+        typedef std::vector<std::unique_ptr<ZygoteHandler> > Handlers;
+        typedef std::unordered_map<pid_t, ZygoteHandler*> PidIndex;
+        typedef std::unordered_map<std::string, pid_t> Aliases;
+
+        ZygoteGroup(const ZygoteGroup&);
+        ZygoteGroup& operator=(const ZygoteGroup&);
+
+        bool isAttached(const std::string& socketPath) const;
+
+        ZygoteChildHandler& childhandler;
+        Handlers handlers;
+        PidIndex byPid;
+        // sockets leading to a zygote which is traced through another one
+        Aliases aliases;
+};
+
+#endif
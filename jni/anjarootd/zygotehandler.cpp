@@ -25,24 +25,41 @@
 #include <sys/un.h>
 
 #include "zygotehandler.h"
+#include "prefetch.h"
+#include "stats.h"
 #include "shared/util.h"
 
-ZygoteHandler::ZygoteHandler(ZygoteChildHandler& childhandler_) :
-    childhandler(childhandler_)
+static stats::Counter signalStops("zygote signal stops");
+
+ZygoteHandler::ZygoteHandler(ZygoteChildHandler& childhandler_,
+        const std::string& socketPath_) : childhandler(childhandler_),
+    socketPath(socketPath_)
 {
-    // both methods will throw if something is wrong
-    pid_t zygotePid = getZygotePid();
+    // all methods will throw if something is wrong
+    pid_t zygotePid = getZygotePid(socketPath);
+    zygote = trace::seize(zygotePid,
+            PTRACE_O_TRACEFORK | PTRACE_O_TRACESYSGOOD);
+    if(zygote)
+    {
+        LOGV(Zygote, "Seized zygote %s (pid: %d)", socketPath.c_str(),
+                zygotePid);
+        return;
+    }
+
+    // old kernel, we have to stop zygote and set the options once we see
+    // the SIGSTOP
     zygote = trace::attach(zygotePid);
-    util::logVerbose("Attached to zygote (pid: %d)", zygotePid);
+    LOGV(Zygote, "Attached to zygote %s (pid: %d)", socketPath.c_str(),
+            zygotePid);
 }
 
 ZygoteHandler::~ZygoteHandler()
 {
-    util::logVerbose("Detaching from zygote...");
+    LOGV(Zygote, "Detaching from zygote %d...", zygote->getPid());
     zygote->detach();
 }
 
-pid_t ZygoteHandler::getZygotePid() const
+pid_t ZygoteHandler::getZygotePid(const std::string& socketPath)
 {
     // So... we could iterate through /proc/ to find a process named zygote and
     // read one of the status files where the format is not guaranteed to stay
@@ -59,13 +76,13 @@ pid_t ZygoteHandler::getZygotePid() const
 
     struct sockaddr_un addr = {0, };
     addr.sun_family = AF_UNIX;
-    strcpy(addr.sun_path, "/dev/socket/zygote");
+    strncpy(addr.sun_path, socketPath.c_str(), sizeof(addr.sun_path) - 1);
 
     int ret = connect(fd, reinterpret_cast<struct sockaddr *>(&addr),
             sizeof(addr.sun_family) + sizeof(addr.sun_path));
     if(ret == -1)
     {
-        util::logError("Failed to connect to zygote socket: %s",
+        util::logError("Failed to connect to %s: %s", socketPath.c_str(),
                 strerror(errno));
         close(fd);
         throw std::system_error(errno, std::system_category());
@@ -92,53 +109,93 @@ pid_t ZygoteHandler::getPid() const
     return zygote->getPid();
 }
 
+const std::string& ZygoteHandler::getSocketPath() const
+{
+    return socketPath;
+}
+
 bool ZygoteHandler::handle(const trace::WaitResult& res)
 {
     if(res.hasExited())
     {
-        util::logVerbose("Zygote exited...");
+        LOGV(Zygote, "Zygote exited...");
         zygote->detach();
         return false;
     }
 
     if(res.wasSignaled())
     {
-        util::logVerbose("Zygote received termination signal: %d",
+        LOGV(Zygote, "Zygote received termination signal: %d",
                 res.getTermSignal());
 
         zygote->detach();
         return false;
     }
 
+    // Signal delivery stops are by far the most common ones, every dying app
+    // sends zygote a SIGCHLD. So they come first and cost exactly one ptrace
+    // call. We don't look at the siginfo either: the children are traced
+    // themselves and report their own exits to ZygoteChildHandler.
+    if(res.hasStopped() && res.getEvent() == 0 && !res.inSyscall() &&
+            (zygote->isSeized() || res.getStopSignal() != SIGSTOP))
+    {
+        signalStops.add();
+        zygote->resume(res.getStopSignal());
+        return true;
+    }
+
     if(res.getEvent() == PTRACE_EVENT_FORK)
     {
         pid_t newpid = zygote->getEventMsg();
-        util::logVerbose("Zygote has forked a new child: %d", newpid);
+        LOGV(Zygote, "Zygote %d has forked a new child: %d",
+                zygote->getPid(), newpid);
+        try
+        {
+            policy::getPrefetcher().notifyFork();
+            childhandler.addChild(newpid, zygote->getPid(),
+                    res.getReapTime());
+        }
+        catch(std::exception& e)
+        {
+            // Zygote waits for us in its fork event, whatever went wrong
+            // with the child must not keep it there. The child goes
+            // untraced.
+            util::logError("Failed to add zygote child %d: %s", newpid,
+                    e.what());
+            childhandler.release(newpid);
+        }
 
         zygote->resume();
         return true;
     }
 
+    if(res.isGroupStop())
+    {
+        // somebody stopped zygote, keep it that way till it gets continued
+        LOGV(Zygote, "Zygote entered group-stop (signal %d)",
+                res.getStopSignal());
+        zygote->listen();
+        return true;
+    }
+
+    if(res.isEventStop())
+    {
+        LOGV(Zygote, "Zygote reported event stop, resuming");
+        zygote->resume();
+        return true;
+    }
+
     if(res.hasStopped())
     {
-        if(res.getStopSignal() == SIGCHLD)
-        {
-            siginfo_t siginfo = zygote->getSignalInfo();
-            // well, that's not always correct - SIGCHLDs aren't only send on
-            // child death, but for now we assume that - it's easier
-            util::logVerbose("Zygote received SIGCHILD for %d", siginfo.si_pid);
-            childhandler.removeChildByPid(siginfo.si_pid);
-            zygote->resume(res.getStopSignal());
-        }
-        else if(res.getStopSignal() == SIGSTOP)
+        if(res.getStopSignal() == SIGSTOP && !zygote->isSeized())
         {
-            util::logVerbose("Zygote received SIGSTOP, seting up child trace");
+            LOGV(Zygote, "Zygote received SIGSTOP, seting up child trace");
             zygote->setupChildTrace();
             zygote->resume();
         }
         else
         {
-            util::logVerbose("Zygote resumed with signal %d", res.getStopSignal());
+            LOGV(Zygote, "Zygote resumed with signal %d", res.getStopSignal());
             zygote->resume(res.getStopSignal());
         }
 
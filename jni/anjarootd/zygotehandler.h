@@ -20,23 +20,29 @@
 #ifndef _ANJAROOTD_ZYGOTEHANDLER_H_
 #define _ANJAROOTD_ZYGOTEHANDLER_H_
 
+#include <string>
+
 #include "trace.h"
 #include "zygotechildhandler.h"
 
 class ZygoteHandler
 {
     public:
-        ZygoteHandler(ZygoteChildHandler& childhandler_);
+        ZygoteHandler(ZygoteChildHandler& childhandler_,
+                const std::string& socketPath_);
         ~ZygoteHandler();
 
         pid_t getPid() const;
+        const std::string& getSocketPath() const;
         bool handle(const trace::WaitResult& res);
 
+        static pid_t getZygotePid(const std::string& socketPath);
+
     private:
-        pid_t getZygotePid() const;
 
         trace::Tracee::Ptr zygote;
         ZygoteChildHandler& childhandler;
+        std::string socketPath;
 };
 
 #endif
@@ -104,7 +104,7 @@ bool CRC32::compareFiles(const std::string& left, const std::string& right)
         bool equal = CRC32::compareStreams(leftStream, rightStream);
         if(equal)
         {
-            util::logVerbose("CRC32 sums of %s and %s are equal", left.c_str(),
+            LOGV(Installer, "CRC32 sums of %s and %s are equal", left.c_str(),
                     right.c_str());
         }
         else
@@ -101,47 +101,47 @@ ModeSpec processArguments(int argc, char** argv)
         switch(c)
         {
             case 'd':
-                util::logVerbose("Opt: -d set to '%s'", optarg);
+                LOGV(Installer, "Opt: -d set to '%s'", optarg);
                 daemonpath = optarg;
                 break;
             case 's':
-                util::logVerbose("Opt: -s set to '%s'", optarg);
+                LOGV(Installer, "Opt: -s set to '%s'", optarg);
                 sourcelib = optarg;
                 break;
             case 'a':
-                util::logVerbose("Opt: -a set to '%s'", optarg);
+                LOGV(Installer, "Opt: -a set to '%s'", optarg);
                 apk = optarg;
                 break;
             case 'i':
-                util::logVerbose("Opt: -i");
+                LOGV(Installer, "Opt: -i");
                 mode = modes::InstallMode;
                 break;
             case 'c':
-                util::logVerbose("Opt: -c");
+                LOGV(Installer, "Opt: -c");
                 mode = modes::CheckMode;
                 break;
             case 'u':
-                util::logVerbose("Opt: -u");
+                LOGV(Installer, "Opt: -u");
                 mode = modes::UninstallMode;
                 break;
             case 'r':
-                util::logVerbose("Opt: -r");
+                LOGV(Installer, "Opt: -r");
                 mode = modes::RecoveryInstallMode;
                 break;
             case 'y':
-                util::logVerbose("Opt: -y");
+                LOGV(Installer, "Opt: -y");
                 mode = modes::RebootRecoveryMode;
                 break;
             case 'm':
-                util::logVerbose("Opt: -m");
+                LOGV(Installer, "Opt: -m");
                 mode = modes::RebootSystemMode;
                 break;
             case 'v':
-                util::logVerbose("opt: -v");
+                LOGV(Installer, "opt: -v");
                 mode = modes::VersionMode;
                 return std::make_tuple(modes::VersionMode, "", "", "");
             case 'h':
-                util::logVerbose("opt: -h");
+                LOGV(Installer, "opt: -h");
                 return std::make_tuple(modes::HelpMode, "", "", "");
             default:
                 return std::make_tuple(modes::InvalidMode, "", "", "");
@@ -178,7 +178,7 @@ int main(int argc, char** argv)
     }
 
 
-    util::logVerbose("Installer (version %s) started",
+    LOGV(Installer, "Installer (version %s) started",
             version::asString().c_str());
 
     ModeSpec spec = processArguments(argc, argv);
@@ -240,13 +240,13 @@ int main(int argc, char** argv)
     {
         const char* msg = "Positive status returned from execution";
         std::cout << msg << std::endl;
-        util::logVerbose(msg);
+        LOGV(Installer, "%s", msg);
     } else {
         const char* msg = "Negativ status returned from execution";
         std::cerr << msg << std::endl;
         util::logError(msg);
     }
 
-    util::logVerbose("Installer finished");
+    LOGV(Installer, "Installer finished");
     return ret == modes::OK ? 0 : 1;
 }
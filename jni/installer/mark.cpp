@@ -64,7 +64,7 @@ bool exists()
     bool exists = operations::access(config::installMarkPath, F_OK);
     if(!exists)
     {
-        util::logVerbose("Mark file %s doesn't exist",
+        LOGV(Installer, "Mark file %s doesn't exist",
                 config::installMarkPath.c_str());
         return false;
     }
@@ -74,7 +74,7 @@ bool exists()
     {
         operations::stat(config::installMarkPath, st);
         const time_t created = st.st_ctime;
-        util::logVerbose("Mark exists, created on: %s", ctime(&created));
+        LOGV(Installer, "Mark exists, created on: %s", ctime(&created));
         return true;
     }
     catch(std::exception& e)
@@ -36,7 +36,7 @@ namespace modes {
 ReturnCode install(const std::string& libpath, const std::string& daemonpath,
         const std::string& apkpath)
 {
-    util::logVerbose("Running install mode");
+    LOGV(Installer, "Running install mode");
 
     // check if there is an install mark
     if(mark::exists())
@@ -231,12 +231,12 @@ ReturnCode uninstall()
     // BEWARE: don't let an exception escape here as there is already one
     //         active if we come from modes::instal! Catch and handle them!
 
-    util::logVerbose("Running uninstall mode");
+    LOGV(Installer, "Running uninstall mode");
 
     try
     {
         operations::unlink(config::installedLibraryPath);
-        util::logVerbose("Removed %s", config::installedLibraryPath.c_str());
+        LOGV(Installer, "Removed %s", config::installedLibraryPath.c_str());
     }
     catch(std::exception& e)
     {
@@ -247,7 +247,7 @@ ReturnCode uninstall()
     {
         operations::move(config::newDebuggerdPath,
                 config::originalDebuggerdPath);
-        util::logVerbose("Moved %s back to %s",
+        LOGV(Installer, "Moved %s back to %s",
                 config::newDebuggerdPath.c_str(),
                 config::originalDebuggerdPath.c_str());
     }
@@ -259,7 +259,7 @@ ReturnCode uninstall()
     try
     {
         operations::unlink(config::apkSystemPath);
-        util::logVerbose("Removed %s", config::apkSystemPath.c_str());
+        LOGV(Installer, "Removed %s", config::apkSystemPath.c_str());
     }
     catch(std::exception& e)
     {
@@ -269,7 +269,7 @@ ReturnCode uninstall()
     try
     {
         operations::unlink(config::installerPath);
-        util::logVerbose("Removed %s", config::installerPath.c_str());
+        LOGV(Installer, "Removed %s", config::installerPath.c_str());
     }
     catch(std::exception& e)
     {
@@ -279,7 +279,7 @@ ReturnCode uninstall()
     try
     {
         operations::unlink(config::installMarkPath);
-        util::logVerbose("Removed %s", config::installMarkPath.c_str());
+        LOGV(Installer, "Removed %s", config::installMarkPath.c_str());
     }
     catch(std::exception& e)
     {
@@ -299,7 +299,7 @@ ReturnCode check()
     // would have to verify every binary and the wrapper script and it may be
     // quite hard to do so, think of version updates etc.
 
-    util::logVerbose("Running check mode");
+    LOGV(Installer, "Running check mode");
 
     if(!mark::verify())
     {
@@ -311,7 +311,7 @@ ReturnCode check()
 
 ReturnCode recoveryInstall(const std::string& apkpath)
 {
-    util::logVerbose("Running recovery install mode");
+    LOGV(Installer, "Running recovery install mode");
 
     try
     {
@@ -347,7 +347,7 @@ ReturnCode recoveryInstall(const std::string& apkpath)
 
 ReturnCode rebootIntoRecovery()
 {
-    util::logVerbose("Booting into recovery");
+    LOGV(Installer, "Booting into recovery");
 
     int ret = operations::reboot(true) ? FAIL : OK;
     return ret != 0 ? FAIL : OK;
@@ -355,7 +355,7 @@ ReturnCode rebootIntoRecovery()
 
 ReturnCode rebootSystem()
 {
-    util::logVerbose("Rebooting system");
+    LOGV(Installer, "Rebooting system");
 
     int ret = operations::reboot(false) ? FAIL : OK;
     return ret != 0 ? FAIL : OK;
@@ -37,7 +37,7 @@ namespace operations {
 
 std::string readFile(const std::string& target)
 {
-    util::logVerbose("Op: readFile '%s'", target.c_str());
+    LOGV(Installer, "Op: readFile '%s'", target.c_str());
 
     try
     {
@@ -56,7 +56,7 @@ std::string readFile(const std::string& target)
 
 void writeFile(const std::string& target, const std::string& content)
 {
-    util::logVerbose("Op: writeFile '%s'", target.c_str());
+    LOGV(Installer, "Op: writeFile '%s'", target.c_str());
 
     try
     {
@@ -73,7 +73,7 @@ void writeFile(const std::string& target, const std::string& content)
 
 void move(const std::string& src, const std::string& dst)
 {
-    util::logVerbose("Op: rename '%s' to '%s'", src.c_str(), dst.c_str());
+    LOGV(Installer, "Op: rename '%s' to '%s'", src.c_str(), dst.c_str());
 
     int ret = ::rename(src.c_str(), dst.c_str());
     if(ret == -1)
@@ -85,7 +85,7 @@ void move(const std::string& src, const std::string& dst)
 
 void copy(const std::string& src, const std::string& dst)
 {
-    util::logVerbose("Op: copy '%s' to '%s'", src.c_str(), dst.c_str());
+    LOGV(Installer, "Op: copy '%s' to '%s'", src.c_str(), dst.c_str());
 
     try
     {
@@ -103,7 +103,7 @@ void copy(const std::string& src, const std::string& dst)
 
 void unlink(const std::string& target)
 {
-    util::logVerbose("Op: unlink '%s'", target.c_str());
+    LOGV(Installer, "Op: unlink '%s'", target.c_str());
 
     int ret = ::unlink(target.c_str());
     if(ret == -1)
@@ -115,7 +115,7 @@ void unlink(const std::string& target)
 
 void stat(const std::string& target, struct stat& out)
 {
-    util::logVerbose("Op: stat on '%s'", target.c_str());
+    LOGV(Installer, "Op: stat on '%s'", target.c_str());
 
     int ret = ::stat(target.c_str(), &out);
     if(ret == -1)
@@ -128,7 +128,7 @@ void stat(const std::string& target, struct stat& out)
 void chown(const std::string& target, const std::string& user,
         const std::string& group)
 {
-    util::logVerbose("Op: chown on '%s' with user='%s', group='%s'",
+    LOGV(Installer, "Op: chown on '%s' with user='%s', group='%s'",
             target.c_str(), user.c_str(), group.c_str());
 
     struct passwd* pwd = getpwnam(user.c_str());
@@ -150,7 +150,7 @@ void chown(const std::string& target, const std::string& user,
 
 void chown(const std::string& target, uid_t uid, gid_t gid)
 {
-    util::logVerbose("Op: chown on '%s' with uid=%d, gid=%d", target.c_str(),
+    LOGV(Installer, "Op: chown on '%s' with uid=%d, gid=%d", target.c_str(),
             uid, gid);
 
     int ret = ::chown(target.c_str(), uid, gid);
@@ -163,7 +163,7 @@ void chown(const std::string& target, uid_t uid, gid_t gid)
 
 void chmod(const std::string& target, mode_t mode)
 {
-    util::logVerbose("Op: chmod on '%s' with mode=%o", target.c_str(), mode);
+    LOGV(Installer, "Op: chmod on '%s' with mode=%o", target.c_str(), mode);
 
     int ret = ::chmod(target.c_str(), mode);
     if(ret == -1)
@@ -175,7 +175,7 @@ void chmod(const std::string& target, mode_t mode)
 
 void mkdir(const std::string& dir, mode_t mode)
 {
-    util::logVerbose("Op: mkdir '%s' with mode=%o", dir.c_str(), mode);
+    LOGV(Installer, "Op: mkdir '%s' with mode=%o", dir.c_str(), mode);
 
     int ret = ::mkdir(dir.c_str(), mode);
     if(ret == -1)
@@ -190,7 +190,7 @@ void mkdir(const std::string& dir, mode_t mode)
 
 int reboot(bool bootRecovery)
 {
-    util::logVerbose("Op: reboot with bootRecovery=%d", bootRecovery);
+    LOGV(Installer, "Op: reboot with bootRecovery=%d", bootRecovery);
 
     // Now the hack: libcutils.so has a function (android_reboot.c) to reboot
     // the device into recovery mode. Unfortunately this is not part of the ndk
@@ -213,7 +213,7 @@ int reboot(bool bootRecovery)
     char cmd[] = "recovery";
     if(!android_reboot)
     {
-        util::logVerbose("Failed to resolve symbol, doing legacy reboot.");
+        LOGV(Installer, "Failed to resolve symbol, doing legacy reboot.");
 
         // emulate androids reboot toolbox utility a bit
         sync();
@@ -234,7 +234,7 @@ int reboot(bool bootRecovery)
         const int ANDROID_RB_RESTART2 = 0xDEAD0003;
         const int ANDROID_RB_RESTART = 0xDEAD0001;
 
-        util::logVerbose("Using libcutils reboot method");
+        LOGV(Installer, "Using libcutils reboot method");
         if(bootRecovery)
         {
             // Value stolen from: include/cutils/android_reboot.h
@@ -258,7 +258,7 @@ int reboot(bool bootRecovery)
 
 bool access(const std::string& target, int mode)
 {
-    util::logVerbose("Op: access on %s with mode=%d", target.c_str(), mode);
+    LOGV(Installer, "Op: access on %s with mode=%d", target.c_str(), mode);
 
     int ret = ::access(target.c_str(), mode);
 
@@ -275,7 +275,7 @@ bool access(const std::string& target, int mode)
 
 void sync()
 {
-    util::logVerbose("Op: sync");
+    LOGV(Installer, "Op: sync");
     ::sync();
 }
 
@@ -49,7 +49,7 @@ Capabilities getCapabilities(pid_t pid)
     caps.permitted = data.permitted;
     caps.inheritable = data.inheritable;
 
-    util::logVerbose("getCapabilities: effective=0x%X, permitted=0x%X, "
+    LOGV(Lib, "getCapabilities: effective=0x%X, permitted=0x%X, "
             "inheritable=0x%X", caps.effective, caps.permitted,
             caps.inheritable);
 
@@ -58,7 +58,7 @@ Capabilities getCapabilities(pid_t pid)
 
 void setCapabilities(const Capabilities& caps)
 {
-    util::logVerbose("setCapabilities: effective=0x%X, permitted=0x%X, "
+    LOGV(Lib, "setCapabilities: effective=0x%X, permitted=0x%X, "
             "inheritable=0x%X", caps.effective, caps.permitted,
             caps.inheritable);
 
@@ -94,7 +94,7 @@ UserIds getUserIds()
         throw std::system_error(errno, std::system_category());
     }
 
-    util::logVerbose("getUserIds: ruid=%d, euid=%d, suid=%d", uids.ruid,
+    LOGV(Lib, "getUserIds: ruid=%d, euid=%d, suid=%d", uids.ruid,
             uids.euid, uids.suid);
 
     return uids;
@@ -102,7 +102,7 @@ UserIds getUserIds()
 
 void setUserIds(const UserIds& uids)
 {
-    util::logVerbose("setUserIds: ruid=%d, euid=%d, suid=%d", uids.ruid,
+    LOGV(Lib, "setUserIds: ruid=%d, euid=%d, suid=%d", uids.ruid,
             uids.euid, uids.suid);
 
     int ret = setresuid(uids.ruid, uids.euid, uids.suid);
@@ -131,7 +131,7 @@ GroupIds getGroupIds()
         throw std::system_error(errno, std::system_category());
     }
 
-    util::logVerbose("getGroupIds: rgid=%d, egid=%d, sgid=%d", gids.rgid,
+    LOGV(Lib, "getGroupIds: rgid=%d, egid=%d, sgid=%d", gids.rgid,
             gids.egid, gids.sgid);
 
     return gids;
@@ -139,7 +139,7 @@ GroupIds getGroupIds()
 
 void setGroupIds(const GroupIds& gids)
 {
-    util::logVerbose("setGroupIds: rgid=%d, egid=%d, sgid=%d", gids.rgid,
+    LOGV(Lib, "setGroupIds: rgid=%d, egid=%d, sgid=%d", gids.rgid,
             gids.egid, gids.sgid);
 
     int ret = setresgid(gids.rgid, gids.egid, gids.sgid);
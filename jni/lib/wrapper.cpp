@@ -271,11 +271,11 @@ jintArray jni_getversion(JNIEnv* env, jclass cls)
 void jni_setcompatmode(JNIEnv*, jclass cls, jint apilvl)
 {
     // We are at apilvl 1, nothing to do here =)
-    util::logVerbose("Library API level: %d", apilvl);
+    LOGV(Lib, "Library API level: %d", apilvl);
 
     if(apilvl < 2)
     {
-        util::logVerbose("Enabling CAP_SETCAP compat mode");
+        LOGV(Lib, "Enabling CAP_SETCAP compat mode");
         SetCapCompatMode = true;
     }
 }
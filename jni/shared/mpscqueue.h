@@ -0,0 +1,126 @@
+/*
+ * Copyright 2013 Simon Brakhane
+ *
+ * This file is part of AnJaRoot.
+ *
+ * AnJaRoot is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * AnJaRoot is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * AnJaRoot. If not, see http://www.gnu.org/licenses/.
+ */
+
+#ifndef _ANJAROOT_MPSCQUEUE_H_
+#define _ANJAROOT_MPSCQUEUE_H_
+
+#include <atomic>
+#include <cstddef>
+#include <stdint.h>
+
+namespace util
+{
+    // Bounded lock-free queue for any number of producer threads and exactly
+    // one consumer thread (Dmitry Vyukov's bounded queue). Every cell carries
+    // a sequence number telling whether it is free for the producer claiming
+    // position pos (sequence == pos) or filled for the consumer
+    // (sequence == pos + 1). Producers only race on tail, with a CAS.
+    //
+    // Items are filled and consumed in place, log lines are too big to be
+    // copied around twice.
+    template<typename T, std::size_t Capacity>
+    class MpscQueue
+    {
+        static_assert((Capacity & (Capacity - 1)) == 0,
+                "Capacity has to be a power of two");
+
+        public:
+            MpscQueue() : tail(0), head(0)
+            {
+                for(std::size_t i = 0; i < Capacity; i++)
+                {
+                    cells[i].sequence.store(i, std::memory_order_relaxed);
+                }
+            }
+
+            // producer side, fill gets a T& to write to, returns false if the
+            // queue is full
+            template<typename F>
+            bool push(F fill)
+            {
+                Cell* cell;
+                std::size_t pos = tail.load(std::memory_order_relaxed);
+                while(true)
+                {
+                    cell = &cells[pos & (Capacity - 1)];
+                    std::size_t seq =
+                        cell->sequence.load(std::memory_order_acquire);
+                    intptr_t diff = static_cast<intptr_t>(seq) -
+                        static_cast<intptr_t>(pos);
+                    if(diff == 0)
+                    {
+                        if(tail.compare_exchange_weak(pos, pos + 1,
+                                    std::memory_order_relaxed))
+                        {
+                            break;
+                        }
+                    }
+                    else if(diff < 0)
+                    {
+                        // the consumer didn't get to this cell yet
+                        return false;
+                    }
+                    else
+                    {
+                        // another producer was faster
+                        pos = tail.load(std::memory_order_relaxed);
+                    }
+                }
+
+                fill(cell->item);
+                cell->sequence.store(pos + 1, std::memory_order_release);
+                return true;
+            }
+
+            // consumer side, consume gets a const T&, returns false if the
+            // queue is empty
+            template<typename F>
+            bool pop(F consume)
+            {
+                Cell* cell = &cells[head & (Capacity - 1)];
+                std::size_t seq = cell->sequence.load(std::memory_order_acquire);
+                if(seq != head + 1)
+                {
+                    return false;
+                }
+
+                consume(static_cast<const T&>(cell->item));
+                cell->sequence.store(head + Capacity, std::memory_order_release);
+                head++;
+                return true;
+            }
+
+        private:
+            struct Cell
+            {
+                std::atomic<std::size_t> sequence;
+                T item;
+            };
+
+            MpscQueue(const MpscQueue&);
+            MpscQueue& operator=(const MpscQueue&);
+
+            std::atomic<std::size_t> tail;
+            // only touched by the consumer
+            std::size_t head;
+            Cell cells[Capacity];
+    };
+}
+
+#endif
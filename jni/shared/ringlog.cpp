@@ -0,0 +1,271 @@
+/*
+ * Copyright 2013 Simon Brakhane
+ *
+ * This file is part of AnJaRoot.
+ *
+ * AnJaRoot is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * AnJaRoot is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * AnJaRoot. If not, see http://www.gnu.org/licenses/.
+ */
+
+#include <algorithm>
+#include <vector>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "ringlog.h"
+
+const uint32_t util::RingLog::DefaultSegmentSize = 64 * 1024;
+const uint32_t util::RingLog::DefaultSegmentCount = 4;
+const uint32_t util::RingLog::Magic = 0x474c5241; // "ARLG"
+const uint32_t util::RingLog::Version = 1;
+// leaves some room for the header to grow
+const std::size_t util::RingLog::HeaderSize = 64;
+
+// No logging in here, we are what logging ends up in.
+
+static bool writeAll(int fd, const char* data, std::size_t length)
+{
+    while(length > 0)
+    {
+        ssize_t ret = write(fd, data, length);
+        if(ret == -1)
+        {
+            if(errno == EINTR)
+            {
+                continue;
+            }
+            return false;
+        }
+
+        data += ret;
+        length -= ret;
+    }
+
+    return true;
+}
+
+util::RingLog::RingLog() : mapping(MAP_FAILED), mappingSize(0), header(0)
+{
+}
+
+util::RingLog::~RingLog()
+{
+    if(mapping != MAP_FAILED)
+    {
+        // a static one may still get log lines after this, isOpen has to
+        // say no before the mapping is gone
+        header = 0;
+        munmap(mapping, mappingSize);
+        mapping = MAP_FAILED;
+    }
+}
+
+bool util::RingLog::open(const char* path, uint32_t segmentSize,
+        uint32_t segmentCount)
+{
+    if(isOpen() || segmentCount == 0 ||
+            segmentSize <= sizeof(SegmentHeader))
+    {
+        return false;
+    }
+
+    std::size_t size = HeaderSize +
+        static_cast<std::size_t>(segmentSize) * segmentCount;
+
+    int fd = ::open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0666);
+    if(fd == -1)
+    {
+        return false;
+    }
+
+    struct stat st;
+    bool reuse = fstat(fd, &st) == 0 &&
+        static_cast<std::size_t>(st.st_size) == size;
+    if(!reuse && !create(fd, size))
+    {
+        close(fd);
+        return false;
+    }
+
+    void* addr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if(addr == MAP_FAILED)
+    {
+        return false;
+    }
+
+    Header* h = static_cast<Header*>(addr);
+    if(!isValid(h, size) || h->segmentSize != segmentSize)
+    {
+        // something else had the same size, start over
+        memset(addr, 0, size);
+        h->magic = Magic;
+        h->version = Version;
+        h->segmentSize = segmentSize;
+        h->segmentCount = segmentCount;
+        h->current = 0;
+        h->sequence = 1;
+        reinterpret_cast<SegmentHeader*>(
+                static_cast<char*>(addr) + HeaderSize)->sequence = 1;
+    }
+
+    mapping = addr;
+    mappingSize = size;
+    header = h;
+    return true;
+}
+
+bool util::RingLog::create(int fd, std::size_t size)
+{
+    // Write the whole file instead of ftruncate'ing a sparse one, a full
+    // disk must not turn into SIGBUS on some later append. Everything is
+    // zero, which open turns into a valid ring.
+    if(ftruncate(fd, 0) == -1)
+    {
+        return false;
+    }
+
+    static const char zeros[4096] = {0, };
+    while(size > 0)
+    {
+        std::size_t chunk = std::min(size, sizeof(zeros));
+        if(!writeAll(fd, zeros, chunk))
+        {
+            return false;
+        }
+        size -= chunk;
+    }
+
+    return true;
+}
+
+bool util::RingLog::isOpen() const
+{
+    return header != 0;
+}
+
+bool util::RingLog::isValid(const Header* header, std::size_t size)
+{
+    return size >= HeaderSize && header->magic == Magic &&
+        header->version == Version && header->segmentCount != 0 &&
+        header->segmentSize > sizeof(SegmentHeader) &&
+        HeaderSize + static_cast<std::size_t>(header->segmentSize) *
+            header->segmentCount == size &&
+        header->current < header->segmentCount;
+}
+
+util::RingLog::SegmentHeader* util::RingLog::getSegment(uint32_t index) const
+{
+    char* base = static_cast<char*>(mapping) + HeaderSize;
+    return reinterpret_cast<SegmentHeader*>(base +
+            static_cast<std::size_t>(index) * header->segmentSize);
+}
+
+void util::RingLog::append(const char* data, std::size_t length)
+{
+    if(!isOpen())
+    {
+        return;
+    }
+
+    std::size_t capacity = header->segmentSize - sizeof(SegmentHeader);
+    length = std::min(length, capacity);
+
+    SegmentHeader* segment = getSegment(header->current);
+    if(segment->used + length > capacity)
+    {
+        rotate();
+        segment = getSegment(header->current);
+    }
+
+    char* dest = reinterpret_cast<char*>(segment + 1) + segment->used;
+    memcpy(dest, data, length);
+    segment->used += length;
+}
+
+void util::RingLog::rotate()
+{
+    uint32_t next = (header->current + 1) % header->segmentCount;
+    SegmentHeader* segment = getSegment(next);
+
+    // empty it first, a reader must never see old data with a new sequence
+    segment->used = 0;
+    segment->sequence = ++header->sequence;
+    header->current = next;
+}
+
+bool util::RingLog::dump(const char* path, int fd)
+{
+    int in = ::open(path, O_RDONLY | O_CLOEXEC);
+    if(in == -1)
+    {
+        return false;
+    }
+
+    struct stat st;
+    if(fstat(in, &st) == -1 ||
+            static_cast<std::size_t>(st.st_size) < HeaderSize)
+    {
+        close(in);
+        errno = EINVAL;
+        return false;
+    }
+
+    std::size_t size = st.st_size;
+    void* addr = mmap(NULL, size, PROT_READ, MAP_SHARED, in, 0);
+    close(in);
+    if(addr == MAP_FAILED)
+    {
+        return false;
+    }
+
+    const Header* h = static_cast<const Header*>(addr);
+    if(!isValid(h, size))
+    {
+        munmap(addr, size);
+        errno = EINVAL;
+        return false;
+    }
+
+    typedef std::pair<uint64_t, const SegmentHeader*> Entry;
+    std::vector<Entry> segments;
+    const char* base = static_cast<const char*>(addr) + HeaderSize;
+    for(uint32_t i = 0; i < h->segmentCount; i++)
+    {
+        const SegmentHeader* segment = reinterpret_cast<const SegmentHeader*>(
+                base + static_cast<std::size_t>(i) * h->segmentSize);
+        if(segment->sequence != 0)
+        {
+            segments.push_back(Entry(segment->sequence, segment));
+        }
+    }
+    std::sort(segments.begin(), segments.end());
+
+    std::size_t capacity = h->segmentSize - sizeof(SegmentHeader);
+    bool result = true;
+    for(std::vector<Entry>::const_iterator iter = segments.begin();
+            result && iter != segments.end(); iter++)
+    {
+        const SegmentHeader* segment = iter->second;
+        result = writeAll(fd, reinterpret_cast<const char*>(segment + 1),
+                std::min<std::size_t>(segment->used, capacity));
+    }
+
+    munmap(addr, size);
+    return result;
+}
@@ -0,0 +1,92 @@
+/*
+ * Copyright 2013 Simon Brakhane
+ *
+ * This file is part of AnJaRoot.
+ *
+ * AnJaRoot is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * AnJaRoot is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * AnJaRoot. If not, see http://www.gnu.org/licenses/.
+ */
+
+#ifndef _ANJAROOT_RINGLOG_H_
+#define _ANJAROOT_RINGLOG_H_
+
+#include <cstddef>
+#include <stdint.h>
+
+namespace util
+{
+    // A log file of fixed size: a header followed by segmentCount segments,
+    // all mapped into memory. Lines are appended to the current segment,
+    // if one doesn't fit anymore the oldest segment gets reused. Every
+    // segment records its sequence number and how much of it is used, so
+    // the reader can put them back in order, see dump.
+    class RingLog
+    {
+        public:
+            static const uint32_t DefaultSegmentSize;
+            static const uint32_t DefaultSegmentCount;
+
+            RingLog();
+            ~RingLog();
+
+            // keeps what an existing ring of the same geometry holds,
+            // anything else is replaced
+            bool open(const char* path,
+                    uint32_t segmentSize = DefaultSegmentSize,
+                    uint32_t segmentCount = DefaultSegmentCount);
+            bool isOpen() const;
+            void append(const char* data, std::size_t length);
+
+            // writes the lines of the ring at path to fd, oldest first
+            static bool dump(const char* path, int fd);
+
+        private:
+            struct Header
+            {
+                uint32_t magic;
+                uint32_t version;
+                uint32_t segmentSize;
+                uint32_t segmentCount;
+                // the write cursor, together with the segment's used field
+                uint32_t current;
+                uint32_t reserved;
+                uint64_t sequence;
+            };
+
+            struct SegmentHeader
+            {
+                // 0 if never written
+                uint64_t sequence;
+                uint32_t used;
+                uint32_t reserved;
+            };
+
+            static const uint32_t Magic;
+            static const uint32_t Version;
+            static const std::size_t HeaderSize;
+
+            RingLog(const RingLog&);
+            RingLog& operator=(const RingLog&);
+
+            static bool isValid(const Header* header, std::size_t size);
+            static bool create(int fd, std::size_t size);
+            SegmentHeader* getSegment(uint32_t index) const;
+            void rotate();
+
+            void* mapping;
+            std::size_t mappingSize;
+            Header* header;
+    };
+}
+
+#endif
@@ -16,63 +16,399 @@
  * You should have received a copy of the GNU General Public License along with
  * AnJaRoot. If not, see http://www.gnu.org/licenses/.
  */
-
-#include <fstream>
-#include <sstream>
+#include <atomic>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <semaphore.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
 
+#include "mpscqueue.h"
+#include "ringlog.h"
 #include "util.h"
 
-static std::ofstream logstream;
+// longer lines get truncated
+static const std::size_t MaxLineLength = 512;
+static const std::size_t QueueCapacity = 256;
 
-namespace util {
+// both static and never closed, the kernel writes them back for us
+static int textLog = -1;
+static util::RingLog ringLog;
 
-void log(android_LogPriority prio, const char* format, va_list vargs)
+// localtime and strftime are the expensive part of a line, but the timestamp
+// only changes once a second.
+static time_t cachedSecond = -1;
+static char cachedTime[64];
+
+static void writeLine(android_LogPriority prio, time_t when, const char* text)
 {
-    if(logstream.is_open())
+    if(textLog == -1 && !ringLog.isOpen())
     {
-        char buf[1024];
-        std::size_t size = vsnprintf(buf, sizeof(buf), format, vargs);
-        if(size > 0)
+        __android_log_write(prio, ANJAROOT_LOGTAG, text);
+        return;
+    }
+
+    if(when != cachedSecond)
+    {
+        struct tm tinfo;
+        localtime_r(&when, &tinfo);
+        strftime(cachedTime, sizeof(cachedTime), "%Y-%m-%dT%H:%M:%S%z",
+                &tinfo);
+        cachedSecond = when;
+    }
+
+    char line[MaxLineLength + 96];
+    int size = snprintf(line, sizeof(line), "[%s][%d] %s\n", cachedTime, prio,
+            text);
+    if(size <= 0)
+    {
+        return;
+    }
+    if(static_cast<std::size_t>(size) >= sizeof(line))
+    {
+        size = sizeof(line) - 1;
+        line[size - 1] = '\n';
+    }
+
+    if(ringLog.isOpen())
+    {
+        // just a memcpy into the mapping, nothing buffered we could loose
+        ringLog.append(line, size);
+        return;
+    }
+
+    // not buffered either, a failed write only costs that line
+    const char* data = line;
+    while(size > 0)
+    {
+        ssize_t ret = write(textLog, data, size);
+        if(ret == -1 && errno == EINTR)
+        {
+            continue;
+        }
+        if(ret <= 0)
+        {
+            return;
+        }
+
+        data += ret;
+        size -= ret;
+    }
+}
+
+namespace
+{
+    struct LogLine
+    {
+        android_LogPriority prio;
+        time_t when;
+        char text[MaxLineLength];
+    };
+
+    // The logging threads only format into a queue slot, the writer thread
+    // does the rest. The writer sleeps on a semaphore and only gets posted
+    // if it said it's going to sleep, that saves a syscall per line while
+    // it's busy anyway.
+    class AsyncLog
+    {
+        public:
+            // never destroyed, see startAsyncLogging
+            AsyncLog();
+
+            bool start();
+            void stop();
+            void push(android_LogPriority prio, const char* format,
+                    va_list vargs);
+
+        private:
+            AsyncLog(const AsyncLog&);
+            AsyncLog& operator=(const AsyncLog&);
+
+            static void* threadMain(void* arg);
+            void run();
+            std::size_t drain();
+
+            util::MpscQueue<LogLine, QueueCapacity> queue;
+            sem_t wakeup;
+            pthread_t thread;
+            std::atomic<bool> running;
+            std::atomic<bool> sleeping;
+            std::atomic<unsigned int> dropped;
+    };
+}
+
+AsyncLog::AsyncLog() : running(false), sleeping(false), dropped(0)
+{
+    sem_init(&wakeup, 0, 0);
+}
+
+bool AsyncLog::start()
+{
+    running.store(true);
+    int ret = pthread_create(&thread, NULL, &AsyncLog::threadMain, this);
+    if(ret != 0)
+    {
+        running.store(false);
+        errno = ret;
+        return false;
+    }
+
+    return true;
+}
+
+void AsyncLog::stop()
+{
+    running.store(false);
+    sem_post(&wakeup);
+    pthread_join(thread, NULL);
+
+    // a line might have slipped in after the writer's last look
+    drain();
+}
+
+void AsyncLog::push(android_LogPriority prio, const char* format,
+        va_list vargs)
+{
+    bool queued = queue.push([&] (LogLine& line) {
+            line.prio = prio;
+            line.when = time(NULL);
+            vsnprintf(line.text, sizeof(line.text), format, vargs);
+        });
+    if(!queued)
+    {
+        dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    // pairs with the fence in run, either we see the writer sleeping or it
+    // sees our line
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if(sleeping.load(std::memory_order_relaxed) && sleeping.exchange(false))
+    {
+        sem_post(&wakeup);
+    }
+}
+
+void* AsyncLog::threadMain(void* arg)
+{
+    static_cast<AsyncLog*>(arg)->run();
+    return NULL;
+}
+
+void AsyncLog::run()
+{
+    while(running.load())
+    {
+        if(drain() != 0)
+        {
+            continue;
+        }
+
+        sleeping.store(true);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if(drain() == 0 && running.load())
+        {
+            while(sem_wait(&wakeup) == -1 && errno == EINTR);
+        }
+        sleeping.store(false);
+    }
+
+    drain();
+}
+
+std::size_t AsyncLog::drain()
+{
+    std::size_t count = 0;
+    while(queue.pop([] (const LogLine& line) {
+                writeLine(line.prio, line.when, line.text);
+            }))
+    {
+        count++;
+    }
+
+    unsigned int lost = dropped.exchange(0);
+    if(lost != 0)
+    {
+        char text[64];
+        snprintf(text, sizeof(text), "Log queue full, dropped %u lines", lost);
+        writeLine(ANDROID_LOG_ERROR, time(NULL), text);
+    }
+
+    return count;
+}
+
+static std::atomic<AsyncLog*> asyncLog(nullptr);
+
+// runs before main, a command line switch can still override it
+static struct LogLevelsFromEnv
+{
+    LogLevelsFromEnv()
+    {
+        util::logLevels[util::LogSyscall].store(ANDROID_LOG_SILENT);
+
+        const char* spec = getenv("ANJAROOT_LOG");
+        if(spec)
+        {
+            util::setLogLevels(spec);
+        }
+    }
+} logLevelsFromEnv;
+
+// only the forking thread survives a fork, the writer is gone
+static void disableAsyncLogging()
+{
+    asyncLog.store(nullptr);
+}
+
+static const char* subsystemNames[util::LogSubsystemCount] = {
+    "general",
+    "trace",
+    "hook",
+    "syscall",
+    "policy",
+    "zygote",
+    "lib",
+    "installer",
+};
+
+static bool parseLevel(const char* name, std::size_t length, int& level)
+{
+    static const struct
+    {
+        const char* name;
+        int level;
+    } levels[] = {
+        {"verbose", ANDROID_LOG_VERBOSE},
+        {"debug", ANDROID_LOG_DEBUG},
+        {"info", ANDROID_LOG_INFO},
+        {"warn", ANDROID_LOG_WARN},
+        {"error", ANDROID_LOG_ERROR},
+        {"silent", ANDROID_LOG_SILENT},
+    };
+
+    for(std::size_t i = 0; i < sizeof(levels) / sizeof(levels[0]); i++)
+    {
+        if(strlen(levels[i].name) == length &&
+                strncmp(levels[i].name, name, length) == 0)
+        {
+            level = levels[i].level;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static bool parseSubsystem(const char* name, std::size_t length,
+        int& subsystem)
+{
+    for(int i = 0; i < util::LogSubsystemCount; i++)
+    {
+        if(strlen(subsystemNames[i]) == length &&
+                strncmp(subsystemNames[i], name, length) == 0)
         {
-            char timestr[128] = {0, };
-            time_t now;
-            struct tm* tinfo;
+            subsystem = i;
+            return true;
+        }
+    }
 
-            time(&now);
-            tinfo = localtime(&now);
+    return false;
+}
 
-            strftime(timestr, sizeof(timestr), "%Y-%m-%dT%H:%M:%S%z", tinfo);
+namespace util {
 
-            std::stringstream strstream;
-            strstream << "[" << timestr << "][" << prio << "] " << buf <<
-                std::endl;
+std::atomic<int> logLevels[LogSubsystemCount];
 
-            logstream << strstream.str();
+bool setLogLevels(const char* spec)
+{
+    bool valid = true;
+    const char* item = spec;
+    while(*item != '\0')
+    {
+        const char* end = strchr(item, ',');
+        if(!end)
+        {
+            end = item + strlen(item);
+        }
+
+        const char* eq = static_cast<const char*>(
+                memchr(item, '=', end - item));
+        int level = 0;
+        int subsystem = -1;
+        if(eq && parseSubsystem(item, eq - item, subsystem) &&
+                parseLevel(eq + 1, end - eq - 1, level))
+        {
+            logLevels[subsystem].store(level, std::memory_order_relaxed);
         }
+        else if(!eq && parseLevel(item, end - item, level))
+        {
+            for(int i = 0; i < LogSubsystemCount; i++)
+            {
+                logLevels[i].store(level, std::memory_order_relaxed);
+            }
+        }
+        else if(end != item)
+        {
+            logError("Invalid log level: %.*s", static_cast<int>(end - item),
+                    item);
+            valid = false;
+        }
+
+        item = *end == ',' ? end + 1 : end;
+    }
+
+    return valid;
+}
+
+void log(android_LogPriority prio, const char* format, va_list vargs)
+{
+    // callers like to log first and throw errno afterwards
+    int savedErrno = errno;
+
+    AsyncLog* async = asyncLog.load(std::memory_order_acquire);
+    if(async)
+    {
+        async->push(prio, format, vargs);
     }
     else
     {
-        __android_log_vprint(prio, ANJAROOT_LOGTAG, format, vargs);
+        char buf[MaxLineLength];
+        int size = vsnprintf(buf, sizeof(buf), format, vargs);
+        if(size > 0)
+        {
+            writeLine(prio, time(NULL), buf);
+        }
     }
+
+    errno = savedErrno;
 }
 
-void logError(const char* format, ...)
+void logAt(LogSubsystem subsystem, android_LogPriority prio,
+        const char* format, ...)
 {
     va_list vargs;
     va_start(vargs, format);
 
-    log(ANDROID_LOG_ERROR, format, vargs);
+    log(prio, format, vargs);
 
     va_end(vargs);
 }
 
-void logVerbose(const char* format, ...)
+void logError(const char* format, ...)
 {
+    if(!isLogEnabled(LogGeneral, ANDROID_LOG_ERROR))
+    {
+        return;
+    }
+
     va_list vargs;
     va_start(vargs, format);
 
-    log(ANDROID_LOG_VERBOSE, format, vargs);
+    log(ANDROID_LOG_ERROR, format, vargs);
 
     va_end(vargs);
 }
@@ -80,9 +416,60 @@ void logVerbose(const char* format, ...)
 void setupFileLogging(const char* file)
 {
     // TODO a logrotate would be cool, otherwise we have to truncate...
-    logstream.open(file, std::ios::trunc);
-    // disable buffering, we would loose data, it's static and never closed
-    logstream.rdbuf()->pubsetbuf(0, 0);
+    textLog = open(file, O_WRONLY | O_CREAT | O_TRUNC | O_APPEND | O_CLOEXEC,
+            0666);
+    if(textLog == -1)
+    {
+        logError("Failed to open log file %s: %s", file, strerror(errno));
+    }
+}
+
+void setupRingLogging(const char* file)
+{
+    if(!ringLog.open(file))
+    {
+        logError("Failed to open log ring %s: %s", file, strerror(errno));
+    }
+}
+
+bool dumpRingLog(const char* file, int fd)
+{
+    return RingLog::dump(file, fd);
+}
+
+bool startAsyncLogging()
+{
+    if(asyncLog.load())
+    {
+        return true;
+    }
+
+    static bool forkHandlerInstalled = false;
+    if(!forkHandlerInstalled)
+    {
+        pthread_atfork(NULL, NULL, &disableAsyncLogging);
+        forkHandlerInstalled = true;
+    }
+
+    // never freed, a late logger may still hold on to it
+    static AsyncLog* async = new AsyncLog();
+    if(!async->start())
+    {
+        logError("Failed to start log writer: %s", strerror(errno));
+        return false;
+    }
+
+    asyncLog.store(async, std::memory_order_release);
+    return true;
+}
+
+void stopAsyncLogging()
+{
+    AsyncLog* async = asyncLog.exchange(nullptr);
+    if(async)
+    {
+        async->stop();
+    }
 }
 
 }
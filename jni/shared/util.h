@@ -20,13 +20,86 @@
 #ifndef _ANJAROOT_UTIL_H_
 #define _ANJAROOT_UTIL_H_
 
+#include <atomic>
 #include <android/log.h>
 
+// Log calls below this priority are compiled out, set in Android.mk
+#ifndef ANJAROOT_MIN_LOG_LEVEL
+#define ANJAROOT_MIN_LOG_LEVEL ANDROID_LOG_VERBOSE
+#endif
+
 namespace util {
+    // every subsystem has its own runtime level, see setLogLevels
+    enum LogSubsystem
+    {
+        LogGeneral,
+        LogTrace,
+        LogHook,
+        // every single syscall stop, silent by default
+        LogSyscall,
+        LogPolicy,
+        LogZygote,
+        LogLib,
+        LogInstaller,
+        LogSubsystemCount,
+    };
+
+    // Lowest enabled priority per subsystem. Zero (ANDROID_LOG_UNKNOWN)
+    // enables everything, which is what we start with (but for LogSyscall).
+    extern std::atomic<int> logLevels[LogSubsystemCount];
+
+    inline bool isLogEnabled(LogSubsystem subsystem, android_LogPriority prio)
+    {
+        return prio >= ANJAROOT_MIN_LOG_LEVEL &&
+            prio >= logLevels[subsystem].load(std::memory_order_relaxed);
+    }
+
+    // Spec is a comma separated list of "level" (all subsystems) or
+    // "subsystem=level" items, applied in order, e.g. "info,hook=verbose".
+    // Levels are verbose, debug, info, warn, error and silent. Applied from
+    // the ANJAROOT_LOG environment variable at startup.
+    bool setLogLevels(const char* spec);
+
     void log(android_LogPriority prio, const char* format, va_list vargs);
+    void logAt(LogSubsystem subsystem, android_LogPriority prio,
+            const char* format, ...) __attribute__((format(printf, 3, 4)));
     void logError(const char* format, ...);
-    void logVerbose(const char* format, ...);
+    // Logs go to file as plain text instead of logcat
     void setupFileLogging(const char* file);
+    // Logs go to a ring of fixed size at file instead, see RingLog.
+    // dumpRingLog writes its lines to fd, oldest first.
+    void setupRingLogging(const char* file);
+    bool dumpRingLog(const char* file, int fd);
+    // Hands formatting and writing over to a background thread, logging
+    // only copies the line into a queue then. Lines are dropped (and
+    // counted) if the queue is full.
+    bool startAsyncLogging();
+    // Writes out whatever is still queued. Other threads have to be done
+    // logging by now.
+    void stopAsyncLogging();
 }
 
+// Arguments are only evaluated if the level is enabled, disabled levels
+// below ANJAROOT_MIN_LOG_LEVEL don't even make it into the binary.
+// Use like LOGV(Hook, "format", ...).
+#define ANJAROOT_LOG(subsystem, prio, ...) \
+    do \
+    { \
+        if(util::isLogEnabled(util::Log##subsystem, prio)) \
+        { \
+            util::logAt(util::Log##subsystem, prio, __VA_ARGS__); \
+        } \
+    } while(0)
+
+#define LOGV(subsystem, ...) \
+    ANJAROOT_LOG(subsystem, ANDROID_LOG_VERBOSE, __VA_ARGS__)
+#define LOGD(subsystem, ...) \
+    ANJAROOT_LOG(subsystem, ANDROID_LOG_DEBUG, __VA_ARGS__)
+#define LOGI(subsystem, ...) \
+    ANJAROOT_LOG(subsystem, ANDROID_LOG_INFO, __VA_ARGS__)
+#define LOGW(subsystem, ...) \
+    ANJAROOT_LOG(subsystem, ANDROID_LOG_WARN, __VA_ARGS__)
+#define LOGE(subsystem, ...) \
+    ANJAROOT_LOG(subsystem, ANDROID_LOG_ERROR, __VA_ARGS__)
+
 #endif